@@ -6,6 +6,11 @@
 #include <sstream>
 #include <optional>
 #include <map>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <algorithm>
+#include <chrono>
 
 #include "dap/io.h"
 #include "dap/network.h"
@@ -16,6 +21,14 @@
 #include "client.h"
 #include "debugger.h"
 #include "signals.h"
+#include "source_index.h"
+#include "request_worker.h"
+#include "request_reader.h"
+#include "output.h"
+#include "evaluate_cache.h"
+#include "struct_summary.h"
+#include "watch_export.h"
+#include "log_capture.h"
 
 // Define a custom "launch" request type so we can receive specific launch parameters from
 // vscode.
@@ -30,6 +43,17 @@ namespace dap
 
         // A vector of strings for the list of source roots.
         optional<array<string>> sourceRoots;
+
+        // Collapse runs of recursive frames in stack traces.
+        optional<boolean> collapseRecursion;
+
+        // Struct summary formats by type name, added to or replacing the defaults.
+        optional<object> structSummaries;
+
+        // Where to capture the game log, and how much of it to show in the console.
+        optional<string> logDirectory;
+        optional<integer> consoleLinesPerSecond;
+        optional<string> consoleFilter;
     };
 
     struct UnrealAttachRequest : AttachRequest
@@ -41,22 +65,211 @@ namespace dap
 
         // A vector of strings for the list of source roots.
         optional<array<string>> sourceRoots;
+
+        // Collapse runs of recursive frames in stack traces.
+        optional<boolean> collapseRecursion;
+
+        // Struct summary formats by type name, added to or replacing the defaults.
+        optional<object> structSummaries;
+
+        // Where to capture the game log, and how much of it to show in the console.
+        optional<string> logDirectory;
+        optional<integer> consoleLinesPerSecond;
+        optional<string> consoleFilter;
+    };
+
+
+    // One variable of a subtree returned by a "variablesTree" request.
+    struct UnrealVariableNode
+    {
+        string name;
+        optional<string> type;
+        string value;
+
+        // Non-zero if the variable has children. Children below the depth or node budget of the request
+        // can be fetched with this reference as usual.
+        integer variablesReference = 0;
+        optional<integer> namedVariables;
+
+        // The index in the response's node list of this variable's parent, or -1 for the children of the
+        // requested variable.
+        integer parent = -1;
+    };
+
+    struct UnrealVariablesTreeResponse : Response
+    {
+        // The variables of the subtree, each after its parent.
+        array<UnrealVariableNode> variables;
+
+        // True if there were more variables within the requested depth than the node budget allowed.
+        boolean truncated = false;
+    };
+
+    // A custom request for a whole subtree of variables in one round trip, rather than a "variables"
+    // request for each level of the tree.
+    struct UnrealVariablesTreeRequest : Request
+    {
+        using Response = UnrealVariablesTreeResponse;
+
+        // The variable to return the subtree of, as for a "variables" request.
+        integer variablesReference = 0;
+
+        // The number of levels of the tree to return. The requested variable's children are level 1.
+        optional<integer> maxDepth;
+
+        // The most variables to return.
+        optional<integer> maxNodes;
+    };
+
+    struct UnrealExportWatchesResponse : Response
+    {
+        integer bytesWritten = 0;
+        integer watchesWritten = 0;
+
+        // The time taken to write the file, in milliseconds.
+        number milliseconds = 0;
+    };
+
+    // A custom request to write all the watches of a frame to a file.
+    struct UnrealExportWatchesRequest : Request
+    {
+        using Response = UnrealExportWatchesResponse;
+
+        // The frame to export, the top frame if not given.
+        optional<integer> frameId;
+
+        // The file to write. It is replaced if it exists.
+        string path;
+
+        // "jsonl" (the default) or "binary".
+        optional<string> format;
+    };
+
+    // A line of the game log found by a "searchLog" request.
+    struct UnrealLogLine
+    {
+        integer line = 0;
+
+        // When the line was logged, in milliseconds since the Unix epoch.
+        number time = 0;
+
+        string text;
+    };
+
+    struct UnrealSearchLogResponse : Response
+    {
+        array<UnrealLogLine> lines;
+
+        // The number of lines captured so far.
+        integer totalLines = 0;
+
+        // True if there were more matching lines than 'maxResults'. Search again from the line after
+        // the last one returned for more.
+        boolean truncated = false;
     };
 
+    // A custom request to search the captured game log.
+    struct UnrealSearchLogRequest : Request
+    {
+        using Response = UnrealSearchLogResponse;
+
+        // Text the lines must contain, ignoring case. All lines if not given.
+        optional<string> query;
+
+        // Only lines logged in this time range, in milliseconds since the Unix epoch.
+        optional<number> startTime;
+        optional<number> endTime;
+
+        // The first line to consider.
+        optional<integer> startLine;
+
+        // The most lines to return.
+        optional<integer> maxResults;
+    };
 
     DAP_DECLARE_STRUCT_TYPEINFO(UnrealLaunchRequest);
     DAP_DECLARE_STRUCT_TYPEINFO(UnrealAttachRequest);
+    DAP_DECLARE_STRUCT_TYPEINFO(UnrealVariableNode);
+    DAP_DECLARE_STRUCT_TYPEINFO(UnrealVariablesTreeResponse);
+    DAP_DECLARE_STRUCT_TYPEINFO(UnrealVariablesTreeRequest);
+    DAP_DECLARE_STRUCT_TYPEINFO(UnrealExportWatchesResponse);
+    DAP_DECLARE_STRUCT_TYPEINFO(UnrealExportWatchesRequest);
+    DAP_DECLARE_STRUCT_TYPEINFO(UnrealLogLine);
+    DAP_DECLARE_STRUCT_TYPEINFO(UnrealSearchLogResponse);
+    DAP_DECLARE_STRUCT_TYPEINFO(UnrealSearchLogRequest);
 
     DAP_IMPLEMENT_STRUCT_TYPEINFO(UnrealLaunchRequest,
         "launch",
         DAP_FIELD(restart, "__restart"),
         DAP_FIELD(noDebug, "noDebug"),
-        DAP_FIELD(sourceRoots, "sourceRoots"));
+        DAP_FIELD(sourceRoots, "sourceRoots"),
+        DAP_FIELD(collapseRecursion, "collapseRecursion"),
+        DAP_FIELD(structSummaries, "structSummaries"),
+        DAP_FIELD(logDirectory, "logDirectory"),
+        DAP_FIELD(consoleLinesPerSecond, "consoleLinesPerSecond"),
+        DAP_FIELD(consoleFilter, "consoleFilter"));
 
     DAP_IMPLEMENT_STRUCT_TYPEINFO(UnrealAttachRequest,
         "attach",
         DAP_FIELD(restart, "__restart"),
-        DAP_FIELD(sourceRoots, "sourceRoots"));
+        DAP_FIELD(sourceRoots, "sourceRoots"),
+        DAP_FIELD(collapseRecursion, "collapseRecursion"),
+        DAP_FIELD(structSummaries, "structSummaries"),
+        DAP_FIELD(logDirectory, "logDirectory"),
+        DAP_FIELD(consoleLinesPerSecond, "consoleLinesPerSecond"),
+        DAP_FIELD(consoleFilter, "consoleFilter"));
+
+    DAP_IMPLEMENT_STRUCT_TYPEINFO(UnrealVariableNode,
+        "",
+        DAP_FIELD(name, "name"),
+        DAP_FIELD(type, "type"),
+        DAP_FIELD(value, "value"),
+        DAP_FIELD(variablesReference, "variablesReference"),
+        DAP_FIELD(namedVariables, "namedVariables"),
+        DAP_FIELD(parent, "parent"));
+
+    DAP_IMPLEMENT_STRUCT_TYPEINFO(UnrealVariablesTreeResponse,
+        "",
+        DAP_FIELD(variables, "variables"),
+        DAP_FIELD(truncated, "truncated"));
+
+    DAP_IMPLEMENT_STRUCT_TYPEINFO(UnrealVariablesTreeRequest,
+        "variablesTree",
+        DAP_FIELD(variablesReference, "variablesReference"),
+        DAP_FIELD(maxDepth, "maxDepth"),
+        DAP_FIELD(maxNodes, "maxNodes"));
+
+    DAP_IMPLEMENT_STRUCT_TYPEINFO(UnrealExportWatchesResponse,
+        "",
+        DAP_FIELD(bytesWritten, "bytesWritten"),
+        DAP_FIELD(watchesWritten, "watchesWritten"),
+        DAP_FIELD(milliseconds, "milliseconds"));
+
+    DAP_IMPLEMENT_STRUCT_TYPEINFO(UnrealExportWatchesRequest,
+        "exportWatches",
+        DAP_FIELD(frameId, "frameId"),
+        DAP_FIELD(path, "path"),
+        DAP_FIELD(format, "format"));
+
+    DAP_IMPLEMENT_STRUCT_TYPEINFO(UnrealLogLine,
+        "",
+        DAP_FIELD(line, "line"),
+        DAP_FIELD(time, "time"),
+        DAP_FIELD(text, "text"));
+
+    DAP_IMPLEMENT_STRUCT_TYPEINFO(UnrealSearchLogResponse,
+        "",
+        DAP_FIELD(lines, "lines"),
+        DAP_FIELD(totalLines, "totalLines"),
+        DAP_FIELD(truncated, "truncated"));
+
+    DAP_IMPLEMENT_STRUCT_TYPEINFO(UnrealSearchLogRequest,
+        "searchLog",
+        DAP_FIELD(query, "query"),
+        DAP_FIELD(startTime, "startTime"),
+        DAP_FIELD(endTime, "endTime"),
+        DAP_FIELD(startLine, "startLine"),
+        DAP_FIELD(maxResults, "maxResults"));
 }
 
 namespace unreal_debugger::adapter
@@ -66,10 +279,25 @@ using namespace unreal_debugger::client;
 std::unique_ptr<dap::Session> session;
 std::unique_ptr<dap::net::Server> server;
 
+// In server mode sessions come and go as clients connect and disconnect. The main thread waits
+// for a session to begin, runs its IO, and then tears it down, while clients connect on the
+// server's thread.
+std::mutex session_mutex;
+std::condition_variable session_cv;
+
 // Unrealscript debugger does not expose separate threads. We arbitrarily name the sole
 // thread we can access '1'.
 static const int unreal_thread_id = 1;
 
+// If Unreal is already stopped when we connect, the interface reports the stop in the burst of
+// state it sends to every new connection. That can arrive before the client has attached, when it
+// isn't ready to hear about stops yet, so it's held back until the attach response has been sent.
+std::mutex attach_mutex;
+bool attached = false;
+bool pending_stop = false;
+
+static void send_stopped_event();
+
 namespace util
 {
     // Given a source reference, return the unreal class name, qualified with package name.
@@ -106,87 +334,6 @@ namespace util
         return package_name.string() + "." + class_name.string();
     }
 
-    // Normalize a source file path to the true path name on disk. The path that we have built by gluing a user-provided
-    // source root to the package and class name that Unreal provided may not exactly match the true file name of the file
-    // on disk due to casing differences. E.g. the source-root may not have the correct casing, and while fs::exists() ignores
-    // the case differences VS Code currently doesn't do a great job at detecting two different casings of the same file name
-    // as being the same. If the cases don't match and you have opened the file in VS Code (which uses the true file path as it
-    // appears on disk) the debugger may open another copy of this same file when a breakpoint within it is hit but the source
-    // path returned from the debugger doesn't match exactly.
-    //
-    // To help reduce this annoyance the file name is canonicalized to the true path recorded on disk before returning. This
-    // is not simple to do on Windows, we need to actually open the file to query it, and it needs to use gross Win32 APIs.
-    std::string normalize_path(const std::string& path)
-    {
-        HANDLE hnd;
-        char buf[MAX_PATH];
-
-        // Open the file to get a handle
-        hnd = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-        if (hnd == INVALID_HANDLE_VALUE)
-        {
-            log("normalize_path: Could not open file (error %d\n)", GetLastError());
-            return path;
-        }
-
-        // Get the 'final path name' from the handle. Try with a reasonable buffer first, and if that fails allocate
-        // one large enough to hold the result.
-        unsigned long sz = GetFinalPathNameByHandle(hnd, buf, MAX_PATH, 0);
-        std::string str;
-        if (sz < MAX_PATH)
-        {
-            str = buf;
-        }
-        else
-        {
-            auto large_buf = std::make_unique<char[]>(sz + 1);
-            GetFinalPathNameByHandle(hnd, large_buf.get(), sz + 1, 0);
-            str = large_buf.get();
-        }
-
-        // We're now done with the handle
-        CloseHandle(hnd);
-
-        // The returned string may be prefixed with the \\?\ long path prefix. Strip it, cause VS Code doesn't want to
-        // see it.
-        if (str.find(R"(\\?\)") == 0)
-            str = str.substr(4);
-        return str;
-    }
-
-    // Normalizing the source file paths is expensive, so keep a cache of known mappings from class names to source file names.
-    std::map<std::string, std::string> file_name_cache;
-
-    // Given a class name, return a source name by attempting to apply each of the configured source-roots in order.
-    std::string class_to_source(const std::string& class_name)
-    {
-        // Try to find a cached version of the file first.
-        auto  it = file_name_cache.find(class_name);
-        if (it != file_name_cache.end())
-        {
-            return it->second;
-        }
-
-        // No dice. Split the name into package and file name and search the source roots until we find a match
-        // (or don't).
-        auto idx = class_name.find('.');
-        std::string package = class_name.substr(0, idx);
-        std::string file = class_name.substr(idx + 1);
-
-        for (fs::path path : source_roots)
-        {
-            path = path / package / "Classes" / (file + ".uc");
-            if (fs::exists(path))
-            {
-                std::string normalized = normalize_path(path.string());
-                file_name_cache.insert({ class_name, normalized } );
-                return normalized;
-            }
-        }
-        log("Error: Cannot find source path for %s\n", class_name.c_str());
-        return class_name;
-    }
-
     // DAP uses 'variableReferences' to identify scopes and variables within those scopes. These are integer
     // values and must be unique per variable but otherwise have no real meaning to the debugger. We encode
     // the position in the stack frame and watch list in the returned variable reference to make them easy to
@@ -197,33 +344,36 @@ namespace util
     //  Bit 31: always 0
     //  Bit 30: 0 if set, this is a user watch and bit 29 is unset.
     //  Bit 29: 0 for local watch, 1 for global watch
-    //  Bits 28-22: Frame index: 7 bits = 128 possible frames (always 0 for user watches)
-    //  Bits 21-0: Variable index in watch list within frame, + 1: 20 bits, but the 0 value is not used = 4,194,303 possible variables per frame.
+    //  Bits 28-19: Frame index: 10 bits = 1024 possible frames. User watches are evaluated in a given frame and
+    //             carry its index too. Stacks that deep come from runaway recursion, which collapsing recursion
+    //             shows as a few frames whose indices are still those of the full stack, so the field is wide.
+    //  Bits 18-0: Variable index in watch list within frame, + 1: 19 bits, but the 0 value is not used = 524,287 possible variables per frame.
     //             The variable index is always offset by 1 from the true index within the debugger watch vector. This is
     //             because the value 0 is special to DAP and so we cannot use it to represent the 0th local variable of the 0th stack frame.
     //             Instead simply shift all variable indices to be 1-indexed instead of 0-indexed. This wastes 1 potential variable slot per
-    //             frame when we really only need to special case the first frame, but 4 million variables is a whole lot anyway.
+    //             frame when we really only need to special case the first frame. Only variables with children need a reference,
+    //             and the elements of large arrays have none, so half a million is plenty.
+    //
+    // A frame or variable beyond these limits gets the reference 0: it is shown, but can't be expanded.
 
     constexpr int variable_encoding_user_bit = 0x4000'0000;
     constexpr int variable_encoding_global_bit = 0x2000'0000;
-    constexpr int variable_encoding_frame_shift = 22;
-    constexpr int variable_encoding_max_frame = 1 << 7;
-    constexpr int variable_encoding_max_var = (1 << 22) - 1;
+    constexpr int variable_encoding_frame_shift = 19;
+    constexpr int variable_encoding_max_frame = 1 << 10;
+    constexpr int variable_encoding_max_var = (1 << 19) - 2;
 
     int encode_variable_reference(int frame_index, int variable_index, watch_kind kind)
     {
-        if (frame_index >= variable_encoding_max_frame)
+        if (frame_index < 0 || frame_index >= variable_encoding_max_frame)
         {
-            std::stringstream stream;
-            stream << "encode_variable_reference: frame index " << frame_index << " exceeds maximum value " << variable_encoding_max_frame;
-            throw std::runtime_error(stream.str());
+            log("encode_variable_reference: frame index %d exceeds maximum value %d\n", frame_index, variable_encoding_max_frame - 1);
+            return 0;
         }
 
-        if (variable_index > variable_encoding_max_var)
+        if (variable_index < 0 || variable_index > variable_encoding_max_var)
         {
-            std::stringstream stream;
-            stream << "encode_variable_reference: variable index " << variable_index << " exceeds maximum value " << variable_encoding_max_var;
-            throw std::runtime_error(stream.str());
+            log("encode_variable_reference: variable index %d exceeds maximum value %d\n", variable_index, variable_encoding_max_var);
+            return 0;
         }
 
         // Offset the internal variable index in the watch list by 1 to avoid the 0 issue for the first frame.
@@ -299,7 +449,7 @@ namespace util
     }
 
     // Convert an iso8859-1 string to utf-8.
-    std::string iso8859_1_to_utf8(const std::string& in)
+    std::string iso8859_1_to_utf8(std::string_view in)
     {
         std::string out;
 
@@ -319,6 +469,68 @@ namespace util
 
 namespace handlers
 {
+    // The response to a request that was cancelled.
+    static dap::Error cancelled_error()
+    {
+        return dap::Error("cancelled");
+    }
+
+    // The response to a request for a frame that isn't in the call stack, such as one from an earlier stop.
+    static dap::Error no_such_frame_error()
+    {
+        return dap::Error("No such frame");
+    }
+
+    // What a queued request needs to know to decide whether it is still worth finishing.
+    struct request_context
+    {
+        cancel_token cancelled;
+
+        // The stop the request was made in.
+        stop_token stop;
+
+        // True once the request has been cancelled or the stop it was made in is over.
+        bool abandoned() const { return *cancelled || stop.stale(); }
+    };
+
+    // Wrap a handler so that it runs on the request worker rather than on cppdap's dispatch
+    // thread, and can be cancelled. A request that is abandoned before it starts is not run at all.
+    template <typename Request, typename Response>
+    auto queued(dap::ResponseOrError<Response>(*handler)(const Request&, const request_context&))
+    {
+        return [handler](const Request& request, std::function<void(dap::ResponseOrError<Response>)> respond) {
+            std::optional<std::int64_t> seq = requests.claim(dap::TypeOf<Request>::type()->name());
+            worker.post([handler, request, respond, stop = stop_token{}](const cancel_token& cancelled) {
+                request_context ctx{ cancelled, stop };
+                if (ctx.abandoned())
+                {
+                    respond(cancelled_error());
+                    return;
+                }
+                respond(handler(request, ctx));
+            }, seq);
+        };
+    }
+
+    // Execution is about to change: anything still being fetched for the current stop is now
+    // useless. Cancel it and wait for it to wind down before talking to Unreal.
+    static void interrupt_requests()
+    {
+        worker.cancel_all();
+
+        // Wake a request waiting for the stop to progress so it sees it has been cancelled.
+        signals::stop_progress.notify();
+        worker.wait_idle();
+    }
+
+    // Unreal is about to be resumed. Move on to a new stop generation, so that everything still
+    // being done for the old stop is dropped, including whatever Unreal is still sending about it.
+    static void interrupt_stop()
+    {
+        debugger.begin_resume();
+        interrupt_requests();
+    }
+
     void error_handler(const char* msg)
     {
         log("Session error: %s\n", msg);
@@ -331,9 +543,64 @@ namespace handlers
         dap::InitializeResponse response;
         response.supportsDelayedStackTraceLoading = true;
         response.supportsValueFormattingOptions = true;
+        response.supportsCancelRequest = true;
+        response.supportsEvaluateForHovers = true;
         return response;
     }
 
+    // Set up the struct summaries from a launch or attach request. Returns the types given a format
+    // that isn't a string.
+    static std::vector<std::string> configure_summaries(const dap::optional<dap::object>& formats)
+    {
+        std::vector<std::string> bad_types;
+        summaries.reset();
+        if (formats)
+        {
+            for (const auto& [type, format] : *formats)
+            {
+                if (format.is<dap::string>())
+                {
+                    summaries.set(type, format.get<dap::string>());
+                }
+                else
+                {
+                    bad_types.push_back(type);
+                }
+            }
+        }
+        return bad_types;
+    }
+
+    static dap::Error bad_summaries_error(const std::vector<std::string>& bad_types)
+    {
+        std::stringstream msg;
+        msg << "Error: Struct summary formats must be strings:" << std::endl;
+        for (const auto& t : bad_types)
+        {
+            msg << t << std::endl;
+        }
+
+        dap::Error err;
+        err.message = msg.str();
+        return err;
+    }
+
+    // Start capturing the game log for a launch or attach request, and set how much of it goes to the console.
+    template <typename Request>
+    static void configure_log(const Request& req)
+    {
+        console_limit.configure(static_cast<int>(req.consoleLinesPerSecond.value(console_throttle::default_lines_per_second)), req.consoleFilter.value(""));
+
+        std::error_code ec;
+        std::filesystem::path dir = req.logDirectory
+            ? std::filesystem::u8path(*req.logDirectory)
+            : std::filesystem::temp_directory_path(ec) / "unrealscript-debugger-log";
+        if (!game_log.open(dir))
+        {
+            log("Could not capture the game log in %s\n", dir.string().c_str());
+        }
+    }
+
     // Handle a 'launch' request.
     dap::ResponseOrError<dap::LaunchResponse> launch_handler(const dap::UnrealLaunchRequest& req)
     {
@@ -354,6 +621,12 @@ namespace handlers
                 return err;
             }
         }
+        collapse_recursion = req.collapseRecursion.value(false);
+        if (auto bad_types = configure_summaries(req.structSummaries); !bad_types.empty())
+        {
+            return bad_summaries_error(bad_types);
+        }
+        configure_log(req);
         return dap::LaunchResponse{};
     }
 
@@ -377,11 +650,31 @@ namespace handlers
                 return err;
             }
         }
+        collapse_recursion = req.collapseRecursion.value(false);
+        if (auto bad_types = configure_summaries(req.structSummaries); !bad_types.empty())
+        {
+            return bad_summaries_error(bad_types);
+        }
+        configure_log(req);
         return dap::AttachResponse{};
     }
 
+    // Handle a 'cancel' request. Only queued requests can be cancelled: the rest are answered before
+    // the cancel is read. A request that isn't in flight has already been answered, and the cancel is
+    // ignored, as are cancels of progress, which the adapter doesn't report.
+    dap::CancelResponse cancel_handler(const dap::CancelRequest& request)
+    {
+        if (request.requestId && worker.cancel(*request.requestId))
+        {
+            // Wake the request if it is waiting for the stop to progress so it sees it has been cancelled.
+            signals::stop_progress.notify();
+        }
+        return {};
+    }
+
     dap::DisconnectResponse disconnect(const dap::DisconnectRequest& request)
     {
+        interrupt_requests();
         stop_debugging();
         return {};
     }
@@ -401,6 +694,9 @@ namespace handlers
 
         std::string class_name = util::source_to_class(request.source);
 
+        // Adding breakpoints waits on Unreal, so must not overlap with a queued request doing the same.
+        worker.wait_idle();
+
         // Tell unreal to clear any existing breakpoints in the file
         if (const std::vector<int>* existing_breakpoints = debugger.get_breakpoints(class_name))
         {
@@ -456,29 +752,125 @@ namespace handlers
         return response;
     }
 
+    // Wait for a signal from the IO thread, giving up if the stop is left in the meantime. Returns
+    // false if the request was abandoned.
+    //
+    // The signal answers a command already sent to Unreal, so a cancelled request still waits for it:
+    // giving up early would leave the reply to answer whatever is sent next. Only leaving the stop, after
+    // which Unreal's replies are dropped, ends the wait early.
+    bool wait_in_stop(signals::signal& signal, const request_context& ctx)
+    {
+        bool fired = signal.wait_unless([&] { return ctx.stop.stale(); });
+        signal.reset();
+        return fired && !ctx.abandoned();
+    }
+
+    // Stops are reported to the client as soon as they begin, and the client's requests may arrive while
+    // Unreal is still describing the stop. Wait until the stop has reached at least the given phase. Returns
+    // false if the request was abandoned.
+    bool wait_for_stop(debugger_state::stop_phase phase, const request_context& ctx)
+    {
+        signals::stop_progress.wait_unless([&] { return debugger.get_stop_phase() >= phase || ctx.abandoned(); });
+        return debugger.get_stop_phase() >= phase && !ctx.abandoned();
+    }
+
     // Change the debugger frame, blocking until the frame has changed. Optionally requests watch info for the new frame.
-    void change_frame_and_wait(int frame, bool with_watches)
+    // Returns false if the request was abandoned.
+    //
+    // Unreal is left on the new frame: nothing switches it back until something needs a different frame. The
+    // debugger's current frame index always tracks the frame Unreal has selected.
+    //
+    // Until the stop is complete Unreal is still sending the top frame's watches and object name, which are
+    // filed under the current frame and would answer a frame change early, so no frame is switched before then.
+    bool change_frame_and_wait(int frame, bool with_watches, const request_context& ctx)
     {
+        if (!wait_for_stop(debugger_state::stop_phase::complete, ctx))
+        {
+            return false;
+        }
+
         debugger.set_current_frame_index(frame);
+
+        // Watch info is only wanted when fetching watches: skip it when we only want the line number.
+        toggle_watch_info(with_watches);
         change_stack(frame);
+        bool changed;
         if (with_watches)
         {
             debugger.set_state(debugger_state::state::waiting_for_frame_watches);
-            signals::watches_received.wait();
-            signals::watches_received.reset();
+            changed = wait_in_stop(signals::watches_received, ctx);
         }
         else
         {
             debugger.set_state(debugger_state::state::waiting_for_frame_line);
-            signals::line_received.wait();
-            signals::line_received.reset();
+            changed = wait_in_stop(signals::line_received, ctx);
         }
 
         debugger.set_state(debugger_state::state::normal);
+        return changed;
+    }
+
+    // An entry in the stack trace shown to the client: either a frame of Unreal's call stack, or a run of
+    // frames collapsed into one.
+    struct trace_entry
+    {
+        int frame_index;
+        int collapsed_count = 0;
+    };
+
+    // Runs of at least this many consecutive frames for the same function are collapsed when collapsing
+    // recursion. The first and last frames of the run are kept and the frames between them are collapsed.
+    constexpr int min_collapsed_run = 4;
+
+    // Build the list of entries to show for a call stack. Without collapsing this is just every frame.
+    //
+    // Deep recursion (tree walks, searches) can leave hundreds of frames for the same function on the
+    // stack. Each frame shown needs its own line number, and each line number needs a round trip to
+    // Unreal to change frames, so when collapsing the innermost and outermost frames of each run are
+    // shown and the frames between them become one entry that is never fetched.
+    std::vector<trace_entry> build_trace(const stop_snapshot& snapshot)
+    {
+        std::vector<trace_entry> trace;
+        int size = static_cast<int>(snapshot.frames.size());
+        trace.reserve(size);
+
+        for (int i = 0; i < size; )
+        {
+            int run_end = i + 1;
+            if (collapse_recursion)
+            {
+                // Names are interned, so comparing them is cheap.
+                const stack_frame& frame = *snapshot.frames[i];
+                while (run_end < size && snapshot.frames[run_end]->function_name == frame.function_name
+                    && snapshot.frames[run_end]->class_name == frame.class_name)
+                {
+                    ++run_end;
+                }
+            }
+
+            int run_length = run_end - i;
+            if (run_length >= min_collapsed_run)
+            {
+                trace.push_back({ i });
+                trace.push_back({ i + 1, run_length - 2 });
+                trace.push_back({ run_end - 1 });
+            }
+            else
+            {
+                for (int j = i; j < run_end; ++j)
+                {
+                    trace.push_back({ j });
+                }
+            }
+
+            i = run_end;
+        }
+
+        return trace;
     }
 
     // Handle a stack trace request.
-    dap::ResponseOrError<dap::StackTraceResponse> stack_trace_handler(const dap::StackTraceRequest& request)
+    dap::ResponseOrError<dap::StackTraceResponse> stack_trace_handler(const dap::StackTraceRequest& request, const request_context& ctx)
     {
         if (request.threadId != unreal_thread_id)
         {
@@ -486,47 +878,72 @@ namespace handlers
             return dap::Error("Unknown thread id :%d", id);
         }
 
+        // The call stack follows the stop's announcement: wait for it. The top frame can be answered as soon as
+        // it arrives; deeper frames whose lines must be fetched wait for the rest of the stop in change_frame_and_wait.
+        if (!wait_for_stop(debugger_state::stop_phase::stack_received, ctx))
+        {
+            return cancelled_error();
+        }
+
         int count = 0;
         dap::StackTraceResponse response;
 
-        // Remember what frame we are currently looking at so we can restore it if we need to change it to
-        // fetch information here.
-        int previous_frame = debugger.get_current_frame_index();
-        bool disabled_watch_info = false;
+        std::shared_ptr<const stop_snapshot> snapshot = debugger.snapshot();
+        std::vector<trace_entry> trace = build_trace(*snapshot);
 
         // Loop over frames requested by the client. The request may start at a frame > 0, and may not request all frames.
-        for (int frame_index = *request.startFrame; frame_index < client::debugger.callstack_size(); ++frame_index)
+        // These are positions in the trace, which with collapsing are not the same as frame indices.
+        for (int trace_index = *request.startFrame; trace_index < trace.size(); ++trace_index)
         {
+            // Fetching a line number means switching frames, so check for cancellation before each one.
+            if (ctx.abandoned())
+            {
+                break;
+            }
+
+            const trace_entry& entry = trace[trace_index];
+            int frame_index = entry.frame_index;
             dap::StackFrame dap_frame;
-            const stack_frame& debugger_frame = debugger.get_stack_frame(frame_index);
 
-            if (debugger_frame.line_number == 0)
+            if (entry.collapsed_count > 0)
             {
-                // We have not yet fetched this frame's line number. Request it now.
-                debugger.set_current_frame_index(frame_index);
-                debugger.set_state(debugger_state::state::waiting_for_frame_line);
-
-                // Tell the debugger interface not to bother sending watch info: we only want line numbers
-                // when swapping frames to build a call stack.
-                if (!disabled_watch_info)
+                // A collapsed run is just a label: it has no line or source and can't be selected, so
+                // nothing needs to be fetched for it.
+                const stack_frame& debugger_frame = *snapshot->frames[frame_index];
+                dap_frame.id = frame_index;
+                dap_frame.line = 0;
+                dap_frame.column = 0;
+                // e.g. "Pkg.Class.Function \u00D7137". The multiplication sign is written out as UTF-8.
+                dap_frame.name = debugger_frame.class_name.str() + "." + debugger_frame.function_name.str()
+                    + " \xC3\x97" + std::to_string(entry.collapsed_count);
+                dap_frame.presentationHint = "label";
+                response.stackFrames.push_back(dap_frame);
+
+                if (++count >= *request.levels)
                 {
-                    toggle_watch_info(false);
-                    disabled_watch_info = true;
+                    break;
                 }
+                continue;
+            }
 
-                // Request a stack change and wait for the line number to be received.
-                change_stack(frame_index);
-                signals::line_received.wait();
-                signals::line_received.reset();
-                debugger.set_state(debugger_state::state::normal);
+            if (snapshot->frames[frame_index]->line_number == 0)
+            {
+                // We have not yet fetched this frame's line number. Request it now.
+                if (!change_frame_and_wait(frame_index, false, ctx))
+                {
+                    break;
+                }
+                snapshot = debugger.snapshot();
             }
 
+            const stack_frame& debugger_frame = *snapshot->frames[frame_index];
+
             dap_frame.id = frame_index;
             dap_frame.line = debugger_frame.line_number;
 
             dap::Source source;
-            source.path = util::class_to_source(debugger_frame.class_name);
-            source.name = debugger_frame.class_name;
+            source.path = sources.class_to_source(source_roots, debugger_frame.class_name.str());
+            source.name = debugger_frame.class_name.str();
 
             dap_frame.source = source;
             dap_frame.column = 0;
@@ -535,10 +952,10 @@ namespace handlers
                 std::string format_str;
                 if (request.format->includeAll || request.format->module)
                 {
-                    format_str += debugger_frame.class_name;
+                    format_str += debugger_frame.class_name.str();
                     format_str += ".";
                 }
-                format_str += debugger_frame.function_name;
+                format_str += debugger_frame.function_name.str();
 
                 if (request.format->includeAll || request.format->line)
                 {
@@ -549,7 +966,7 @@ namespace handlers
             }
             else
             {
-                dap_frame.name = debugger_frame.function_name;
+                dap_frame.name = debugger_frame.function_name.str();
             }
             response.stackFrames.push_back(dap_frame);
 
@@ -560,19 +977,14 @@ namespace handlers
             }
         }
 
-        // Restore the frame index to our original value.
-        if (previous_frame != debugger.get_current_frame_index())
-        {
-            change_frame_and_wait(previous_frame, false);
-        }
-
-        // If we asked the debugger to stop sending watch info, turn it back on now
-        if (disabled_watch_info)
+        // Unreal is left on whichever frame we visited last. There is no need to switch it back: whatever
+        // needs a particular frame next will switch to it.
+        if (ctx.abandoned())
         {
-            toggle_watch_info(true);
+            return cancelled_error();
         }
 
-        response.totalFrames = static_cast<int>(debugger.callstack_size());
+        response.totalFrames = static_cast<int>(trace.size());
 
         return response;
     }
@@ -580,13 +992,19 @@ namespace handlers
     // Handle a request for scope information
     dap::ResponseOrError<dap::ScopesResponse> scopes_handler(const dap::ScopesRequest& request)
     {
+        std::shared_ptr<const stack_frame> frame = debugger.get_stack_frame(request.frameId);
+        if (!frame)
+        {
+            return no_such_frame_error();
+        }
+
         dap::Scope scope;
         scope.name = "Locals";
         scope.presentationHint = "locals";
         scope.variablesReference = util::encode_variable_reference(request.frameId, 0, watch_kind::local);
-        if (debugger.get_stack_frame(request.frameId).fetched_watches)
+        if (frame->fetched_watches)
         {
-            scope.namedVariables = static_cast<int>(debugger.get_stack_frame(request.frameId).local_watches[0].children.size());
+            scope.namedVariables = static_cast<int>(frame->get_watches(watch_kind::local)[0].children.size());
         }
         dap::ScopesResponse response;
         response.scopes.push_back(scope);
@@ -594,40 +1012,96 @@ namespace handlers
         scope.name = "Globals";
         scope.presentationHint = {};
         scope.variablesReference = util::encode_variable_reference(request.frameId, 0, watch_kind::global);
-        if (debugger.get_stack_frame(request.frameId).fetched_watches)
+        if (frame->fetched_watches)
         {
-            scope.namedVariables = static_cast<int>(debugger.get_stack_frame(request.frameId).global_watches[0].children.size());
+            scope.namedVariables = static_cast<int>(frame->get_watches(watch_kind::global)[0].children.size());
         }
         response.scopes.push_back(scope);
         return response;
     }
 
-    void fetch_watches(int frame_index)
+    // Fetch the watches for a frame. Unreal is left on that frame.
+    void fetch_watches(int frame_index, const request_context& ctx)
+    {
+        change_frame_and_wait(frame_index, true, ctx);
+    }
+
+    // Get a frame with its watches, fetching them first if need be. Returns null if the request is abandoned
+    // or there is no such frame.
+    static std::shared_ptr<const stack_frame> frame_with_watches(int frame_index, const request_context& ctx)
+    {
+        // The top frame's watches are still on their way until the stop is complete.
+        if (!wait_for_stop(debugger_state::stop_phase::complete, ctx))
+        {
+            return nullptr;
+        }
+
+        // If we don't have watch info for this frame yet we need to collect it now.
+        std::shared_ptr<const stack_frame> frame = debugger.get_stack_frame(frame_index);
+        if (frame && !frame->fetched_watches)
+        {
+            fetch_watches(frame_index, ctx);
+            frame = debugger.get_stack_frame(frame_index);
+        }
+
+        if (ctx.abandoned())
+        {
+            return nullptr;
+        }
+        return frame;
+    }
+
+    // The response to a request whose frame_with_watches() came back empty.
+    static dap::Error frame_error(const request_context& ctx)
     {
-        int saved_frame_index = debugger.get_current_frame_index();
-        change_frame_and_wait(frame_index, true);
-        debugger.get_current_stack_frame().fetched_watches = true;
+        return ctx.abandoned() ? cancelled_error() : no_such_frame_error();
+    }
 
-        if (debugger.get_current_frame_index() != saved_frame_index)
+    // Describe a watch as a DAP variable.
+    static dap::Variable make_variable(const watch_list& watch_list, int index, int frame_index, watch_kind watch_kind)
+    {
+        watch_view watch = watch_list[index];
+        dap::Variable var;
+        // TODO Can the name be non-ASCII? Not sure if unrealscript supports this directly.
+        var.name = std::string{ watch.name };
+        var.type = std::string{ watch.type };
+
+        // TODO Support other game locales.
+        // The variable value sent from Unreal will be encoded in the game character set. For INT
+        // this is iso8859-1 and may contain accented characters that need to be converted to
+        // UTF-8 prior to sending to DAP or it will throw exceptions encoding the JSON message.
+        std::optional<std::string> summary = summaries.summarize(watch_list, watch);
+        var.value = util::iso8859_1_to_utf8(summary ? std::string_view{ *summary } : watch.value);
+
+        // If this variable has no children then we report its variable reference as 0. Otherwise
+        // we report this variable's index and the client will send a new variable request with this
+        // reference to fetch its children.
+        if (watch.children.empty())
         {
-            // Reset the debugger's internal state to the original callstack.
-            // We don't need var information for this (we already have the previous
-            // frame), so turn it off.
-            change_frame_and_wait(saved_frame_index, false);
+            var.variablesReference = 0;
+            var.namedVariables = 0;
+            var.indexedVariables = 0;
         }
+        else
+        {
+            var.variablesReference = util::encode_variable_reference(frame_index, index, watch_kind);
+            var.namedVariables = static_cast<int>(watch.children.size());
+            var.indexedVariables = 0;
+        }
+        return var;
     }
 
-    dap::ResponseOrError<dap::VariablesResponse> variables_handler(const dap::VariablesRequest& request)
+    dap::ResponseOrError<dap::VariablesResponse> variables_handler(const dap::VariablesRequest& request, const request_context& ctx)
     {
         auto [frame_index, variable_index, watch_kind] = util::decode_variable_reference(request.variablesReference);
 
-        // If we don't have watch info for this frame yet we need to collect it now.
-        if (!debugger.get_stack_frame(frame_index).fetched_watches)
+        std::shared_ptr<const stack_frame> frame = frame_with_watches(frame_index, ctx);
+        if (!frame)
         {
-            fetch_watches(frame_index);
+            return frame_error(ctx);
         }
 
-        const watch_list& watch_list = debugger.get_stack_frame(frame_index).get_watches(watch_kind);
+        const watch_list& watch_list = frame->get_watches(watch_kind);
 
         if (request.start.value(0) != 0 || request.count.value(0) != 0)
         {
@@ -640,103 +1114,299 @@ namespace handlers
         // The watch list can be empty, e.g. local watches for a function with no parameters and no local variables.
         if (!watch_list.empty())
         {
-            const watch_data& parent = watch_list[variable_index];
+            watch_view parent = watch_list[variable_index];
 
             for (int child_index : parent.children)
             {
-                const watch_data& watch = watch_list[child_index];
-                dap::Variable var;
-                // TODO Can the name be non-ASCII? Not sure if unrealscript supports this directly.
-                var.name = watch.name;
-                var.type = watch.type;
-
-                // TODO Support other game locales.
-                // The variable value sent from Unreal will be encoded in the game character set. For INT
-                // this is iso8859-1 and may contain accented characters that need to be converted to
-                // UTF-8 prior to sending to DAP or it will throw exceptions encoding the JSON message.
-                var.value = util::iso8859_1_to_utf8(watch.value);
-
-                // If this variable has no children then we report its variable reference as 0. Otherwise
-                // we report this variable's index and the client will send a new variable request with this
-                // reference to fetch its children.
-                if (watch.children.empty())
+                if (ctx.abandoned())
                 {
-                    var.variablesReference = 0;
-                    var.namedVariables = 0;
-                    var.indexedVariables = 0;
+                    return cancelled_error();
                 }
-                else
+
+                response.variables.push_back(make_variable(watch_list, child_index, frame_index, watch_kind));
+            }
+        }
+
+        return response;
+    }
+
+    // The default and largest budgets for a variables tree request.
+    constexpr int default_tree_depth = 4;
+    constexpr int default_tree_nodes = 1000;
+    constexpr int max_tree_nodes = 100000;
+
+    // Handle a 'variablesTree' request: a whole subtree of the watch tree, breadth first so that a budget
+    // that runs out cuts off the deepest levels. The tree is all in the watch list already, so this costs
+    // no more round trips to Unreal than a single 'variables' request.
+    dap::ResponseOrError<dap::UnrealVariablesTreeResponse> variables_tree_handler(const dap::UnrealVariablesTreeRequest& request, const request_context& ctx)
+    {
+        auto [frame_index, variable_index, watch_kind] = util::decode_variable_reference(request.variablesReference);
+
+        std::shared_ptr<const stack_frame> frame = frame_with_watches(frame_index, ctx);
+        if (!frame)
+        {
+            return frame_error(ctx);
+        }
+
+        const watch_list& watch_list = frame->get_watches(watch_kind);
+        int max_depth = static_cast<int>(request.maxDepth.value(default_tree_depth));
+        int max_nodes = std::clamp(static_cast<int>(request.maxNodes.value(default_tree_nodes)), 0, max_tree_nodes);
+
+        dap::UnrealVariablesTreeResponse response;
+        if (watch_list.empty() || variable_index >= static_cast<int>(watch_list.size()))
+        {
+            return response;
+        }
+
+        // Watches whose children are still to be added: the watch index, its node in the response (-1 for
+        // the requested variable) and its depth.
+        struct pending
+        {
+            int index;
+            int node;
+            int depth;
+        };
+        std::deque<pending> queue{ pending{ variable_index, -1, 0 } };
+
+        while (!queue.empty())
+        {
+            pending next = queue.front();
+            queue.pop_front();
+
+            for (int child_index : watch_list[next.index].children)
+            {
+                if (static_cast<int>(response.variables.size()) >= max_nodes)
+                {
+                    response.truncated = true;
+                    return response;
+                }
+
+                if (ctx.abandoned())
+                {
+                    return cancelled_error();
+                }
+
+                dap::Variable var = make_variable(watch_list, child_index, frame_index, watch_kind);
+                dap::UnrealVariableNode node;
+                node.name = var.name;
+                node.type = var.type;
+                node.value = var.value;
+                node.variablesReference = var.variablesReference;
+                node.namedVariables = var.namedVariables;
+                node.parent = next.node;
+                response.variables.push_back(std::move(node));
+
+                if (var.variablesReference != 0 && next.depth + 1 < max_depth)
                 {
-                    int child_reference = util::encode_variable_reference(frame_index, child_index, watch_kind);
-                    var.variablesReference = watch.children.empty() ? 0 : child_reference;
-                    var.namedVariables = static_cast<int>(watch.children.size());
-                    var.indexedVariables = 0;
+                    queue.push_back(pending{ child_index, static_cast<int>(response.variables.size()) - 1, next.depth + 1 });
                 }
-                response.variables.push_back(var);
             }
         }
 
         return response;
     }
 
-    static dap::EvaluateResponse make_user_watch_response(int frame_index, int index)
+    // Handle an 'exportWatches' request: write a frame's watches to a file.
+    dap::ResponseOrError<dap::UnrealExportWatchesResponse> export_watches_handler(const dap::UnrealExportWatchesRequest& request, const request_context& ctx)
+    {
+        std::string format_name = request.format.value("jsonl");
+        export_format format;
+        if (format_name == "jsonl")
+        {
+            format = export_format::json_lines;
+        }
+        else if (format_name == "binary")
+        {
+            format = export_format::binary;
+        }
+        else
+        {
+            return dap::Error("Unknown export format: " + format_name);
+        }
+
+        // The call stack isn't complete until the stop is.
+        if (!wait_for_stop(debugger_state::stop_phase::complete, ctx))
+        {
+            return cancelled_error();
+        }
+
+        int frame_index = request.frameId ? static_cast<int>(*request.frameId) : 0;
+        std::shared_ptr<const stack_frame> frame = frame_with_watches(frame_index, ctx);
+        if (!frame)
+        {
+            return frame_error(ctx);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        export_stats stats;
+        if (auto error = export_watches(*frame, std::filesystem::u8path(request.path), format, stats))
+        {
+            return dap::Error(*error);
+        }
+
+        dap::UnrealExportWatchesResponse response;
+        response.bytesWritten = static_cast<int64_t>(stats.bytes);
+        response.watchesWritten = static_cast<int64_t>(stats.watches);
+        response.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return response;
+    }
+
+    // Handle a 'searchLog' request. The search reads the capture without waiting on Unreal or on anything
+    // else, so it is handled straight away rather than queued behind the requests about the stop.
+    dap::ResponseOrError<dap::UnrealSearchLogResponse> search_log_handler(const dap::UnrealSearchLogRequest& request)
+    {
+        log_capture::query q;
+        q.text = request.query.value("");
+        if (request.startTime)
+        {
+            q.start_time = static_cast<std::int64_t>(*request.startTime);
+        }
+        if (request.endTime)
+        {
+            q.end_time = static_cast<std::int64_t>(*request.endTime);
+        }
+        q.first_line = static_cast<std::uint64_t>(std::max<std::int64_t>(request.startLine.value(0), 0));
+        q.max_results = static_cast<std::size_t>(std::max<std::int64_t>(request.maxResults.value(1000), 0));
+
+        bool truncated;
+        std::vector<log_capture::line> lines = game_log.search(q, truncated);
+
+        dap::UnrealSearchLogResponse response;
+        response.lines.reserve(lines.size());
+        for (const log_capture::line& l : lines)
+        {
+            dap::UnrealLogLine line;
+            line.line = static_cast<std::int64_t>(l.number);
+            line.time = static_cast<double>(l.time);
+            line.text = util::iso8859_1_to_utf8(l.text);
+            response.lines.push_back(std::move(line));
+        }
+        response.totalLines = static_cast<std::int64_t>(game_log.size());
+        response.truncated = truncated;
+        return response;
+    }
+
+    static dap::EvaluateResponse make_user_watch_response(const stack_frame& frame, int frame_index, int index)
     {
         dap::EvaluateResponse response;
-        const watch_data& watch = debugger.get_stack_frame(frame_index).user_watches[index];
-        response.type = watch.type;
-        response.result = watch.value;
+        const watch_list& list = frame.get_watches(watch_kind::user);
+        watch_view watch = list[index];
+        response.type = std::string{ watch.type };
+        response.result = summaries.summarize(list, watch).value_or(std::string{ watch.value });
         if (!watch.children.empty())
         {
-            response.variablesReference = util::encode_variable_reference(0, index, watch_kind::user);
+            response.variablesReference = util::encode_variable_reference(frame_index, index, watch_kind::user);
             response.namedVariables = static_cast<int>(watch.children.size());
         }
         return response;
     }
 
-    dap::EvaluateResponse evaluate_handler(const dap::EvaluateRequest& request)
+    // Evaluate an expression as a user watch in the given frame.
+    dap::ResponseOrError<dap::EvaluateResponse> evaluate_watch(const std::string& expression, int frame_index, bool hover, const request_context& ctx)
     {
-        if (request.context && *request.context != "watch")
+        std::shared_ptr<const stack_frame> frame = debugger.get_stack_frame(frame_index);
+        if (!frame)
         {
-            dap::EvaluateResponse response;
-            response.result = "Unsupported expression";
-            return response;
+            return no_such_frame_error();
         }
 
-        int frame_index = request.frameId ? static_cast<int>(*request.frameId) : 0;
-
-        if (!debugger.get_stack_frame(frame_index).fetched_watches)
+        if (!frame->fetched_watches)
         {
-            fetch_watches(frame_index);
+            fetch_watches(frame_index, ctx);
+            frame = debugger.get_stack_frame(frame_index);
+            if (!frame)
+            {
+                return cancelled_error();
+            }
         }
 
-        const watch_list& user_watches = debugger.get_stack_frame(frame_index).user_watches;
-
         // If we have existing watches try to find it in the list first. It will be a child
         // of the root node if so, we don't need to search arbitrary children throughout the list.
-        if (int index = debugger.find_user_watch(frame_index, request.expression); index >= 0)
+        if (int index = frame->find_user_watch(expression); index >= 0)
         {
-            return make_user_watch_response(frame_index, index);
+            return make_user_watch_response(*frame, frame_index, index);
         }
 
+        if (ctx.abandoned())
+        {
+            return cancelled_error();
+        }
+
+        // Unreal evaluates watches in the frame it has selected, so it must be on the requested frame. The
+        // result comes back in a watch list, so watch info must be on too.
+        if (debugger.get_current_frame_index() != frame_index && !change_frame_and_wait(frame_index, false, ctx))
+        {
+            return cancelled_error();
+        }
+        toggle_watch_info(true);
+
         // If we've failed to find this watch then we need to request it.
         debugger.set_state(debugger_state::state::waiting_for_user_watches);
-        add_watch(request.expression);
-        signals::user_watches_received.wait();
-        signals::user_watches_received.reset();
+        add_watch(expression);
+        bool received = wait_in_stop(signals::user_watches_received, ctx);
         debugger.set_state(debugger_state::state::normal);
+        if (!received)
+        {
+            return cancelled_error();
+        }
 
         // Now find the watch.
-        if (int index = debugger.find_user_watch(frame_index, request.expression); index >= 0)
+        frame = debugger.get_stack_frame(frame_index);
+        if (!frame)
+        {
+            return cancelled_error();
+        }
+
+        if (int index = frame->find_user_watch(expression); index >= 0)
+        {
+            return make_user_watch_response(*frame, frame_index, index);
+        }
+
+        // We have failed again -- this watch must be bad. A hover over something that isn't a variable
+        // should show nothing at all.
+        if (hover)
         {
-            return make_user_watch_response(frame_index, index);
+            return dap::Error("Invalid watch");
         }
 
-        // We have failed again -- this watch must be bad.
         dap::EvaluateResponse response;
         response.result = "Invalid watch";
         return response;
     }
 
+    dap::ResponseOrError<dap::EvaluateResponse> evaluate_handler(const dap::EvaluateRequest& request, const request_context& ctx)
+    {
+        std::string context = request.context.value("watch");
+        if (context != "watch" && context != "hover")
+        {
+            dap::EvaluateResponse response;
+            response.result = "Unsupported expression";
+            return response;
+        }
+
+        int frame_index = request.frameId ? static_cast<int>(*request.frameId) : 0;
+
+        if (!wait_for_stop(debugger_state::stop_phase::complete, ctx))
+        {
+            return cancelled_error();
+        }
+
+        // Asking again in the same stop gets the same answer.
+        if (auto cached = evaluations.find(ctx.stop.generation(), frame_index, context, request.expression))
+        {
+            return *cached;
+        }
+
+        dap::ResponseOrError<dap::EvaluateResponse> result = evaluate_watch(request.expression, frame_index, context == "hover", ctx);
+
+        // A cancelled evaluation has no answer to remember.
+        if (!ctx.abandoned())
+        {
+            evaluations.insert(ctx.stop.generation(), frame_index, context, request.expression, result);
+        }
+        return result;
+    }
+
     dap::PauseResponse pause_handler(const dap::PauseRequest& request)
     {
         // Any code execution change results in fresh information from unreal so we need to reset
@@ -748,65 +1418,53 @@ namespace handlers
 
     dap::ContinueResponse continue_handler(const dap::ContinueRequest& request)
     {
-        while (debugger.get_state() != debugger_state::state::normal)
-            ;
-
-        toggle_watch_info(true);
-        clear_watch();
+        interrupt_stop();
 
         // Any code execution change results in fresh information from unreal so we need to reset
-        // to the top-most frame.
+        // to the top-most frame. Unreal may still be on another frame if we didn't need to move it back.
+        bool reset_frame = debugger.get_current_frame_index() != 0;
         debugger.set_current_frame_index(0);
         signals::breakpoint_hit.reset();
-        go();
+        resume(commands::resume_kind::go, reset_frame);
         return {};
     }
 
     dap::NextResponse next_handler(const dap::NextRequest& request)
     {
-        while (debugger.get_state() != debugger_state::state::normal)
-            ;
-
-        toggle_watch_info(true);
-        clear_watch();
+        interrupt_stop();
 
         // Any code execution change results in fresh information from unreal so we need to reset
-        // to the top-most frame.
+        // to the top-most frame. Unreal may still be on another frame if we didn't need to move it back.
+        bool reset_frame = debugger.get_current_frame_index() != 0;
         debugger.set_current_frame_index(0);
         signals::breakpoint_hit.reset();
-        step_over();
+        resume(commands::resume_kind::step_over, reset_frame);
         return {};
     }
 
     dap::StepInResponse step_in_handler(const dap::StepInRequest& request)
     {
-        while (debugger.get_state() != debugger_state::state::normal)
-            ;
-
-        toggle_watch_info(true);
-        clear_watch();
+        interrupt_stop();
 
         // Any code execution change results in fresh information from unreal so we need to reset
-        // to the top-most frame.
+        // to the top-most frame. Unreal may still be on another frame if we didn't need to move it back.
+        bool reset_frame = debugger.get_current_frame_index() != 0;
         debugger.set_current_frame_index(0);
         signals::breakpoint_hit.reset();
-        client::step_into();
+        resume(commands::resume_kind::step_into, reset_frame);
         return {};
     }
 
     dap::StepOutResponse step_out_handler(const dap::StepOutRequest& request)
     {
-        while (debugger.get_state() != debugger_state::state::normal)
-            ;
-
-        client::toggle_watch_info(true);
-        client::clear_watch();
+        interrupt_stop();
 
         // Any code execution change results in fresh information from unreal so we need to reset
-        // to the top-most frame.
+        // to the top-most frame. Unreal may still be on another frame if we didn't need to move it back.
+        bool reset_frame = debugger.get_current_frame_index() != 0;
         debugger.set_current_frame_index(0);
         signals::breakpoint_hit.reset();
-        client::step_outof();
+        resume(commands::resume_kind::step_out_of, reset_frame);
         return {};
     }
 }
@@ -815,8 +1473,63 @@ namespace sent_handlers
 {
     void initialize_response(const dap::ResponseOrError<dap::InitializeResponse>&)
     {
-        session->send(dap::InitializedEvent());
+        output.post([] { session->send(dap::InitializedEvent()); });
     }
+
+    // The client is now attached. Report any stop that arrived before it was ready.
+    void client_attached()
+    {
+        bool stopped = false;
+        {
+            std::lock_guard<std::mutex> lock(attach_mutex);
+            attached = true;
+            std::swap(stopped, pending_stop);
+        }
+
+        if (stopped)
+        {
+            send_stopped_event();
+        }
+    }
+
+    void launch_response(const dap::ResponseOrError<dap::LaunchResponse>& response)
+    {
+        if (response.error.message.empty())
+        {
+            client_attached();
+        }
+    }
+
+    void attach_response(const dap::ResponseOrError<dap::AttachResponse>& response)
+    {
+        if (response.error.message.empty())
+        {
+            client_attached();
+        }
+    }
+}
+
+static void send_stopped_event()
+{
+    output.post([] {
+        dap::StoppedEvent ev;
+        ev.reason = "breakpoint";
+        ev.threadId = unreal_thread_id;
+        session->send(ev);
+    });
+}
+
+// Send console output that the output thread has merged together.
+static void send_console_output(const std::string& text)
+{
+    dap::OutputEvent ev;
+    // TODO Support other game locales
+    // The message sent from Unreal will be encoded in the game character set. For INT
+    // this is iso8859-1 and may contain accented characters that need to be converted to
+    // UTF-8 prior to sending to DAP or it will throw exceptions encoding the JSON message.
+    ev.output = util::iso8859_1_to_utf8(text);
+    ev.category = "console";
+    session->send(ev);
 }
 
 // Tell the debug client that the debugger is stopped at a breakpoint.
@@ -827,10 +1540,16 @@ void breakpoint_hit()
 
     signals::breakpoint_hit.fire();
 
-    dap::StoppedEvent ev;
-    ev.reason = "breakpoint";
-    ev.threadId = unreal_thread_id;
-    session->send(ev);
+    {
+        std::lock_guard<std::mutex> lock(attach_mutex);
+        if (!attached)
+        {
+            pending_stop = true;
+            return;
+        }
+    }
+
+    send_stopped_event();
 }
 
 // Tell the debug client that the debugger has produced some log output.
@@ -839,14 +1558,18 @@ void console_message(const std::string& msg)
     if (!session)
         return;
 
-    dap::OutputEvent ev;
-    // TODO Support other game locales
-    // The message sent from Unreal will be encoded in the game character set. For INT
-    // this is iso8859-1 and may contain accented characters that need to be converted to
-    // UTF-8 prior to sending to DAP or it will throw exceptions encoding the JSON message.
-    ev.output = util::iso8859_1_to_utf8(msg) + "\r\n";
-    ev.category = "console";
-    session->send(ev);
+    // Every line is captured, but only some go to the console.
+    game_log.append(msg);
+
+    std::uint64_t held_back = 0;
+    if (!console_limit.allow(msg, held_back))
+        return;
+
+    if (held_back > 0)
+    {
+        output.post_console("[" + std::to_string(held_back) + " more lines in the log: use the searchLog request to see them]\r\n");
+    }
+    output.post_console(msg + "\r\n");
 }
 
 // The debugger has stopped. Send a terminated event to the client. It should respond
@@ -855,14 +1578,15 @@ void debugger_terminated()
 {
     if (!session)
         return;
-    dap::TerminatedEvent ev;
-    session->send(ev);
+    output.post([] { session->send(dap::TerminatedEvent()); });
    // stop_debugger();
 }
 
 void create_adapter()
 {
     session = dap::Session::create();
+    worker.start();
+    output.start(&send_console_output);
 
     // Bind handlers.
     session->onError(&handlers::error_handler);
@@ -872,39 +1596,62 @@ void create_adapter()
     session->registerHandler(&handlers::set_breakpoints_handler);
     session->registerHandler(&handlers::set_exception_breakpoints_handler);
     session->registerHandler(&handlers::threads_handler);
-    session->registerHandler(&handlers::stack_trace_handler);
+    session->registerHandler(handlers::queued(&handlers::stack_trace_handler));
     session->registerHandler(&handlers::scopes_handler);
-    session->registerHandler(&handlers::variables_handler);
+    session->registerHandler(handlers::queued(&handlers::variables_handler));
+    session->registerHandler(handlers::queued(&handlers::variables_tree_handler));
+    session->registerHandler(handlers::queued(&handlers::export_watches_handler));
+    session->registerHandler(&handlers::search_log_handler);
     session->registerHandler(&handlers::pause_handler);
     session->registerHandler(&handlers::continue_handler);
     session->registerHandler(&handlers::next_handler);
     session->registerHandler(&handlers::step_in_handler);
     session->registerHandler(&handlers::step_out_handler);
-    session->registerHandler(&handlers::evaluate_handler);
+    session->registerHandler(handlers::queued(&handlers::evaluate_handler));
+    session->registerHandler(&handlers::cancel_handler);
     session->registerHandler(&handlers::disconnect);
 
     session->registerSentHandler(&sent_handlers::initialize_response);
+    session->registerSentHandler(&sent_handlers::launch_response);
+    session->registerSentHandler(&sent_handlers::attach_response);
 }
 
+// A client has connected to the server. The interface only accepts one controlling connection,
+// so sessions are served one at a time: a client connecting while another is still being served
+// is turned away.
 void on_connect(const std::shared_ptr<dap::ReaderWriter>& streams)
 {
+    std::lock_guard<std::mutex> lock(session_mutex);
+    if (session)
+    {
+        log("Rejecting connection: a session is already active\n");
+        streams->close();
+        return;
+    }
+
+    if (!client::connect_to_interface())
+    {
+        streams->close();
+        return;
+    }
+
     create_adapter();
-    session->bind(streams);
+    session->bind(std::make_shared<request_reader>(streams), std::make_shared<buffered_writer>(streams));
+    session_cv.notify_all();
 }
 
 void start_adapter()
 {
-    create_adapter();
-
-    if (debug_port > 0)
+    if (server_mode)
     {
         server = dap::net::Server::create();
         server->start(debug_port, on_connect);
     }
     else
     {
-        std::shared_ptr<dap::Reader> in = dap::file(stdin, false);
-        std::shared_ptr<dap::Writer> out = dap::file(stdout, false);
+        create_adapter();
+        std::shared_ptr<dap::Reader> in = std::make_shared<request_reader>(dap::file(stdin, false));
+        std::shared_ptr<dap::Writer> out = std::make_shared<buffered_writer>(dap::file(stdout, false));
         session->bind(in, out);
         log("Bound to in/out\n");
     }
@@ -912,6 +1659,10 @@ void start_adapter()
 
 void stop_adapter()
 {
+    signals::abandon_all();
+    worker.stop();
+    output.stop();
+
     if (server)
     {
         server->stop();
@@ -920,4 +1671,45 @@ void stop_adapter()
     server.reset();
 }
 
-}
\ No newline at end of file
+void wait_for_session()
+{
+    std::unique_lock<std::mutex> lock(session_mutex);
+    session_cv.wait(lock, [] { return session != nullptr; });
+}
+
+// The session's IO has stopped: tear the session down and put everything back the way it was
+// before the client connected. The source index is shared by all sessions and is kept.
+void end_session()
+{
+    // Release any handler still waiting on the interface so the session's threads can finish.
+    signals::abandon_all();
+    worker.stop();
+    output.stop();
+
+    std::unique_ptr<dap::Session> old_session;
+    {
+        std::lock_guard<std::mutex> lock(session_mutex);
+        old_session = std::move(session);
+    }
+    old_session.reset();
+
+    signals::clear_all();
+    requests.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(attach_mutex);
+        attached = false;
+        pending_stop = false;
+    }
+
+    source_roots.clear();
+    collapse_recursion = false;
+    summaries.reset();
+    game_log.close();
+    console_limit.configure(console_throttle::default_lines_per_second, "");
+    debugger.reset();
+    client::disconnect_from_interface();
+    log("Session ended\n");
+}
+
+}
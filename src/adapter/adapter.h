@@ -11,4 +11,9 @@ namespace unreal_debugger::adapter
 
     void start_adapter();
     void stop_adapter();
+
+    // Server mode: wait for a client to connect and start a session, and tear it down again
+    // once it has finished.
+    void wait_for_session();
+    void end_session();
 }
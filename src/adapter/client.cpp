@@ -4,29 +4,34 @@
 #include "debugger.h"
 #include "adapter.h"
 #include "signals.h"
+#include "frame_reader.h"
+#include "transport.h"
 
 #include <iostream>
 #include <io.h>
 #include <fcntl.h>
+#include <mutex>
 #include <boost/asio.hpp>
 #include <boost/program_options.hpp>
 
 
 namespace asio = boost::asio;
 namespace serialization = unreal_debugger::serialization;
-using tcp = boost::asio::ip::tcp;
+using protocol = unreal_debugger::transport::protocol;
 
 namespace unreal_debugger::client
 {
 
-static const int default_port = 10077;
-boost::asio::io_context ios;
-std::unique_ptr<tcp::socket> sock;
+std::unique_ptr<boost::asio::io_context> ios;
+std::mutex ios_mutex;
+std::unique_ptr<protocol::socket> sock;
 serialization::locked_message_queue send_queue;
-serialization::message next_event;
-size_t max_event_size = 0;
+std::unique_ptr<serialization::frame_reader<protocol::socket>> reader;
 std::vector<fs::path> source_roots;
+bool collapse_recursion;
 int debug_port;
+bool server_mode;
+transport::config interface_transport;
 debugger_state debugger;
 bool log_enabled;
 FILE* log_file;
@@ -37,54 +42,107 @@ namespace signals {
     signal breakpoint_hit;
     signal user_watches_received;
     signal breakpoint_added;
+    signal stop_progress;
+
+    void abandon_all()
+    {
+        line_received.abandon();
+        watches_received.abandon();
+        breakpoint_hit.abandon();
+        user_watches_received.abandon();
+        breakpoint_added.abandon();
+        stop_progress.abandon();
+    }
+
+    void clear_all()
+    {
+        line_received.clear();
+        watches_received.clear();
+        breakpoint_hit.clear();
+        user_watches_received.clear();
+        stop_progress.clear();
+        breakpoint_added.clear();
+    }
 }
 
-// Schedule an async receive of the next event from the debugger interface.
+// Start receiving events from the debugger interface. Events are dispatched on the IO thread
+// as they arrive, in order.
 void receive_next_event()
+{
+    reader = std::make_unique<serialization::frame_reader<protocol::socket>>(*sock,
+        [](const serialization::message_view& msg) {
+            dispatch_event(msg);
+        },
+        [](const boost::system::error_code& ec) {
+            log("receiving event error: %s\n", ec.message().c_str());
+            adapter::debugger_terminated();
+        });
+
+    reader->start();
+}
+
+// Connect to the debugger interface and start receiving events from it. The IO context is
+// created here but not run: that is up to the caller.
+bool connect_to_interface()
 {
     {
-        boost::asio::async_read(*sock, boost::asio::buffer(&next_event.len_, 4), [](const boost::system::error_code& ec, std::size_t len) {
-            if (ec)
-            {
-                log("receiving event header error: %s", ec.message().c_str());
-                adapter::debugger_terminated();
-                return;
-            }
+        std::lock_guard<std::mutex> lock(ios_mutex);
+        ios = std::make_unique<boost::asio::io_context>();
+    }
 
-            if (len != 4)
+    sock = std::make_unique<protocol::socket>(*ios);
+    boost::system::error_code ec;
+    if (interface_transport.kind == transport::transport_kind::local && interface_transport.path.empty())
+    {
+        // No socket was named: use the newest game that is still listening.
+        ec = boost::asio::error::not_found;
+        for (const std::string& path : transport::socket_candidates())
+        {
+            transport::config cfg = interface_transport;
+            cfg.path = path;
+            sock->close();
+            sock->connect(transport::make_endpoint(cfg, false), ec);
+            if (!ec)
             {
-                log("failed to read next message header: read %zu of 4 bytes\n", len);
-                adapter::debugger_terminated();
-                return;
+                log("Connected to %s\n", path.c_str());
+                break;
             }
+        }
+    }
+    else
+    {
+        sock->connect(transport::make_endpoint(interface_transport, false), ec);
+    }
 
-            // Reuse existing buffer if it's big enough.
-            if (max_event_size < next_event.len_)
-            {
-                next_event.buf_ = std::make_unique<char[]>(next_event.len_);
-                max_event_size = next_event.len_;
-            }
-            
-            boost::asio::async_read(*sock, boost::asio::buffer(next_event.buf_.get(), next_event.len_), [](const boost::system::error_code& ec, std::size_t len) {
-                if (ec)
-                {
-                    log("receiving event body error: %s", ec.message().c_str());
-                    adapter::debugger_terminated();
-                    return;
-                }
-
-                if (len != next_event.len_)
-                {
-                    log("failed to read next message body: received %zu of %zu bytes\n", len, next_event.len_);
-                    adapter::debugger_terminated();
-                    return;
-                }
-
-                dispatch_event(next_event);
-                receive_next_event();
-            });
-        });
+    if (ec)
+    {
+        log("Connection to debugger failed: %s\n", ec.message().c_str());
+        disconnect_from_interface();
+        return false;
     }
+
+    reset_command_state();
+    receive_next_event();
+    return true;
+}
+
+// Close the connection to the debugger interface. This must not be called while the IO context
+// is running. Any handlers still pending on the old context are destroyed without being run, so
+// nothing from a finished session can leak into the next one.
+void disconnect_from_interface()
+{
+    if (sock)
+    {
+        boost::system::error_code ec;
+        sock->close(ec);
+    }
+
+    reader.reset();
+    sock.reset();
+    send_queue.take_all();
+
+    std::lock_guard<std::mutex> lock(ios_mutex);
+    ios.reset();
 }
 
 void send_next_message()
@@ -143,7 +201,11 @@ void send_command(const commands::command& cmd)
 // thread to begin the cleanup of the DAP connection and ultimately exit the process.
 void stop_debugger()
 {
-   ios.stop();
+    std::lock_guard<std::mutex> lock(ios_mutex);
+    if (ios)
+    {
+        ios->stop();
+    }
 }
 
 void log(const char* msg, ...)
@@ -163,22 +225,47 @@ int main(int argc, char *argv[])
 {
     using namespace unreal_debugger;
 
-    // Currently only accepts 1 command line option: -debug <port>
-
-    if (argc == 3)
+    // Command line options:
+    //
+    // -server <port>: Run as a long-lived server talking DAP over the given tcp port instead of
+    //                 stdin/stdout. Sessions are served one at a time until the process is killed.
+    // -debug <port>: As -server, and also log to stdout.
+    // -port <port>: Connect to the debugger interface over TCP on the given port.
+    // -socket <path>: Connect to the debugger interface over the local socket with the given path.
+    //
+    // The interface connection defaults to the transport named by the environment (see transport.h).
+    client::interface_transport = transport::config_from_environment();
+
+    for (int i = 1; i + 1 < argc; i += 2)
     {
-        if (strcmp(argv[1], "-debug") == 0)
+        if (strcmp(argv[i], "-server") == 0)
         {
-            client::debug_port = atoi(argv[2]);
+            client::debug_port = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-debug") == 0)
+        {
+            client::debug_port = atoi(argv[i + 1]);
+            client::log_enabled = true;
+        }
+        else if (strcmp(argv[i], "-port") == 0)
+        {
+            client::interface_transport.kind = transport::transport_kind::tcp;
+            client::interface_transport.port = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-socket") == 0)
+        {
+            client::interface_transport.kind = transport::transport_kind::local;
+            client::interface_transport.path = argv[i + 1];
         }
     }
 
-    if (client::debug_port > 0)
+    client::server_mode = client::debug_port > 0;
+
+    if (client::server_mode)
     {
-        // In debug mode we are communicating to VS over a tcp port rather than over stdin/stdout.
-        // Log directly to stdout.
+        // In server mode we are communicating to VS over a tcp port rather than over stdin/stdout,
+        // so stdout is free for logging.
         client::log_file = stdout;
-        client::log_enabled = true;
     }
     else
     {
@@ -189,26 +276,33 @@ int main(int argc, char *argv[])
 
     client::log("Started!\n");
 
-    client::sock = std::make_unique<tcp::socket>(client::ios);
-    boost::system::error_code ec;
-    client::sock->connect(tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), client::default_port), ec);
-    if (ec)
+    if (client::server_mode)
+    {
+        // Each session connects to the interface when its client connects to us. Run the IO
+        // for each session in turn on this thread, tearing the session down when it ends.
+        adapter::start_adapter();
+
+        for (;;)
+        {
+            adapter::wait_for_session();
+            client::ios->run();
+            adapter::end_session();
+        }
+    }
+
+    if (!client::connect_to_interface())
     {
-        client::log("Connection to debugger failed: %s\n", ec.message().c_str());
         return 1;
     }
 
     adapter::start_adapter();
 
-    // Schedule an async read of the next event from the debugger, then let
-    // boost::asio do its thing.
-    client::receive_next_event();
-
     // Start running the main thread loop (responsible for reading events from the
     // debugger interface and dispatching them).
-    client::ios.run();
+    client::ios->run();
 
     // We return from 'run' when the debugger has asked to shut down. Shut down the
     // dap service.
     adapter::stop_adapter();
+    client::disconnect_from_interface();
 }
@@ -6,6 +6,7 @@
 #include "dap/io.h"
 #include "commands.h"
 #include "events.h"
+#include "transport.h"
 
 namespace fs = std::filesystem;
 namespace serialization = unreal_debugger::serialization;
@@ -21,14 +22,23 @@ void log(const char* msg, ...);
 
 // Options
 extern std::vector<fs::path> source_roots;
+extern bool collapse_recursion;
 extern int debug_port;
+extern bool server_mode;
+extern transport::config interface_transport;
+
+// Connection to the debugger interface. Each session gets a fresh connection and a fresh IO
+// context to run it on.
+extern std::unique_ptr<boost::asio::io_context> ios;
+bool connect_to_interface();
+void disconnect_from_interface();
 
 void stop_debugger();
 
 // Message passing
 extern serialization::locked_message_queue send_queue;
 void send_command(const commands::command& command);
-void dispatch_event(const serialization::message& msg);
+void dispatch_event(const serialization::message_view& msg);
 
 // Commands
 void remove_breakpoint(const std::string& class_name, int line);
@@ -41,11 +51,11 @@ void set_data_watch(const std::string& var_name);
 void break_on_none(bool b);
 
 void break_cmd();
-void go();
-void step_over();
-void step_into();
-void step_outof();
+void resume(commands::resume_kind kind, bool reset_frame);
 void stop_debugging();
 
 void toggle_watch_info(bool b);
+
+// Forget what is known of the interface's state, for a new connection.
+void reset_command_state();
 }
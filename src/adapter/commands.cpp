@@ -1,4 +1,6 @@
 
+#include <atomic>
+
 #include "client.h"
 
 namespace unreal_debugger::client
@@ -6,6 +8,18 @@ namespace unreal_debugger::client
 
 namespace commands = unreal_debugger::serialization::commands;
 
+// The state of the interface as far as the adapter knows it, so that commands that would not change
+// anything needn't be sent. Whether Unreal has any user watches isn't known until the adapter has
+// cleared them once, so assume it does.
+std::atomic<bool> watch_info_enabled = true;
+std::atomic<bool> user_watches_set = true;
+
+void reset_command_state()
+{
+    watch_info_enabled = true;
+    user_watches_set = true;
+}
+
 void remove_breakpoint(const std::string& class_name, int line)
 {
     send_command(commands::remove_breakpoint{ class_name, line });
@@ -26,24 +40,21 @@ void break_cmd()
     send_command(commands::break_cmd{});
 }
 
-void go()
-{
-    send_command(commands::go{});
-}
-
-void step_over()
-{
-    send_command(commands::step_over{});
-}
-
-void step_into()
-{
-    send_command(commands::step_into{});
-}
-
-void step_outof()
+// Resume Unreal, turning watch info back on and clearing user watches along the way unless they
+// are known to be that way already. If 'reset_frame' is set Unreal is first returned to the top-most frame.
+void resume(commands::resume_kind kind, bool reset_frame)
 {
-    send_command(commands::step_out_of{});
+    int flags = reset_frame ? commands::resume_flags::reset_frame : commands::resume_flags::none;
+    if (!watch_info_enabled.exchange(true))
+    {
+        flags |= commands::resume_flags::enable_watch_info;
+    }
+    if (user_watches_set.exchange(false))
+    {
+        flags |= commands::resume_flags::clear_watches;
+    }
+
+    send_command(commands::resume{ kind, flags });
 }
 
 void change_stack(int stack_id)
@@ -58,17 +69,24 @@ void set_data_watch(const std::string& var_name)
 
 void add_watch(const std::string& var_name)
 {
+    user_watches_set = true;
     send_command(commands::add_watch{ var_name });
 }
 
 void clear_watch()
 {
-    send_command(commands::clear_watch{});
+    if (user_watches_set.exchange(false))
+    {
+        send_command(commands::clear_watch{});
+    }
 }
 
 void toggle_watch_info(bool b)
 {
-    send_command(commands::toggle_watch_info{ b });
+    if (watch_info_enabled.exchange(b) != b)
+    {
+        send_command(commands::toggle_watch_info{ b });
+    }
 }
 
 }
@@ -4,6 +4,7 @@
 #include "debugger.h"
 #include "signals.h"
 
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 
 namespace unreal_debugger::client
@@ -37,12 +38,26 @@ static std::pair<std::string, std::string> split_watch_name(std::string full_nam
     return { "<unknown name>", "<unknown type>" };
 }
 
-watch_list& stack_frame::get_watches(watch_kind kind)
-{
-    return const_cast<watch_list&>(const_cast<const stack_frame*>(this)->get_watches(kind));
-}
-
-const watch_list& stack_frame::get_watches(watch_kind kind) const
+stack_frame::stack_frame() :
+    local_watches{ std::make_shared<watch_list>() },
+    global_watches{ std::make_shared<watch_list>() },
+    user_watches{ std::make_shared<watch_list>() }
+{}
+
+// A frame added to the call stack starts out with no watches, and most frames are never looked at
+// closely enough to get any. Rather than allocating three empty lists for each one they all share
+// the same empty list, which is copied before it is written like any other published list.
+static const std::shared_ptr<watch_list> empty_watches = std::make_shared<watch_list>();
+
+stack_frame::stack_frame(symbol cls, symbol func) :
+    class_name{ cls },
+    function_name{ func },
+    local_watches{ empty_watches },
+    global_watches{ empty_watches },
+    user_watches{ empty_watches }
+{}
+
+std::shared_ptr<watch_list>& stack_frame::get_watches_ptr(watch_kind kind)
 {
     switch (kind)
     {
@@ -54,58 +69,166 @@ const watch_list& stack_frame::get_watches(watch_kind kind) const
     }
 }
 
-// Clear a watch list. For locals and globals they are associated with the current
-// stack frame. User watches are part of the debugger state independent of frame.
+const watch_list& stack_frame::get_watches(watch_kind kind) const
+{
+    return *const_cast<stack_frame*>(this)->get_watches_ptr(kind);
+}
+
+void debugger_state::reset()
+{
+    callstack_.clear();
+    callstack_.resize(1);
+    stack_names_.clear();
+    names_.clear();
+    schemas_.clear();
+    current_frame_ = 0;
+    state_ = state::normal;
+    stop_phase_ = stop_phase::complete;
+    watch_lock_depth_ = 0;
+    breakpoints_.clear();
+    resumes_requested_ = 0;
+    resumes_seen_ = 0;
+    {
+        std::lock_guard<std::mutex> lock(generation_mutex_);
+        ++generation_;
+    }
+    publish();
+}
+
+void debugger_state::begin_resume()
+{
+    {
+        std::lock_guard<std::mutex> lock(generation_mutex_);
+        ++generation_;
+        ++resumes_requested_;
+    }
+
+    // Anything waiting on Unreal for the old stop can give up now.
+    signals::line_received.notify();
+    signals::watches_received.notify();
+    signals::user_watches_received.notify();
+    signals::stop_progress.notify();
+}
+
+void debugger_state::begin_stop()
+{
+    // A new stop: anything started for an earlier one is stale.
+    {
+        std::lock_guard<std::mutex> lock(generation_mutex_);
+        ++generation_;
+    }
+    set_stop_phase(stop_phase::begun);
+}
+
+void debugger_state::set_stop_phase(stop_phase phase)
+{
+    stop_phase_ = phase;
+    signals::stop_progress.notify();
+}
+
+void debugger_state::resumed()
+{
+    // Only count resumes we asked for, in case the interface resumes Unreal on its own.
+    if (resumes_seen_ < resumes_requested_)
+    {
+        ++resumes_seen_;
+    }
+
+    // Unreal's reply to the 'clearwatch' sent along with the resume is skipped with everything
+    // else about the old stop, so clear the user watches here instead, and publish the change so
+    // request threads don't keep reading the old stop's user watches.
+    current_frame_ = 0;
+    clear_watch(watch_kind::user);
+    publish();
+}
+
+void debugger_state::fire_if_current(signals::signal& s)
+{
+    std::lock_guard<std::mutex> lock(generation_mutex_);
+    if (!is_stale())
+    {
+        s.fire();
+    }
+}
+
+void debugger_state::publish()
+{
+    auto next = std::make_shared<stop_snapshot>();
+    next->frames.reserve(callstack_.size());
+
+    for (frame_slot& slot : callstack_)
+    {
+        next->frames.push_back(slot.frame);
+        slot.frame_published = true;
+        std::fill(std::begin(slot.watches_published), std::end(slot.watches_published), true);
+    }
+
+    std::atomic_store(&snapshot_, std::shared_ptr<const stop_snapshot>(std::move(next)));
+}
+
+// Get a frame of the IO thread's call stack for modification, first copying it if it has been published.
+stack_frame& debugger_state::writable_frame(int idx)
+{
+    frame_slot& slot = callstack_[idx];
+    if (slot.frame_published)
+    {
+        slot.frame = std::make_shared<stack_frame>(*slot.frame);
+        slot.frame_published = false;
+    }
+    return *slot.frame;
+}
+
+// Get one of the current frame's watch lists for modification, first copying it if it has been published.
+watch_list& debugger_state::writable_watches(watch_kind kind)
+{
+    int idx = current_frame_;
+    std::shared_ptr<watch_list>& list = writable_frame(idx).get_watches_ptr(kind);
+    bool& published = callstack_[idx].watches_published[static_cast<int>(kind)];
+    if (published)
+    {
+        list = std::make_shared<watch_list>(*list);
+        published = false;
+    }
+    return *list;
+}
+
+// Clear one of the current stack frame's watch lists. Each frame has its own locals,
+// globals and user watches.
 void debugger_state::clear_watch(watch_kind kind)
 {
-    callstack_[current_frame_].get_watches(kind).clear();
-    callstack_[current_frame_].get_watches(kind).emplace_back("ROOT", "N/A", "N/A", -1);
+    // There is no point copying a published list just to clear it: start a new one.
+    int idx = current_frame_;
+    writable_frame(idx).get_watches_ptr(kind) = std::make_shared<watch_list>();
+    callstack_[idx].watches_published[static_cast<int>(kind)] = false;
+    writable_watches(kind).add("ROOT", "N/A", "N/A", -1);
 }
 
 // Ensure there is enough space in the watch list to hold all the watches we are going to add without needing to
 // repeatedly reallocate the vector.
 void debugger_state::reserve_watch_size(watch_kind kind, std::size_t size)
 {
-    watch_list& list = callstack_[current_frame_].get_watches(kind);
-    list.reserve(size);
+    writable_watches(kind).reserve(size);
 }
 
 void debugger_state::add_watch(watch_kind kind, int index, int parent, const std::string& full_name, const std::string& value)
 {
-    watch_list& list = callstack_[current_frame_].get_watches(kind);
+    watch_list& list = writable_watches(kind);
 
     // Ensure we have a root element before adding anything more. The root element is at index 0.
     if (list.empty())
     {
         // Insert a dummy root value with no type or value.
-        list.emplace_back("ROOT", "N/A", "N/A", -1);
-    }
-
-    // Watch elements from the debug interface will be inserted into the watchlist data structure at the positions they were assigned by the
-    // debugger interface. Make sure the list is big enough to hold this element.
-    if (list.capacity() <= index)
-    {
-        list.reserve(list.capacity() * 2);
+        list.add("ROOT", "N/A", "N/A", -1);
     }
 
     // Parse the watch 'name', which actually includes name info, type info, and address (currently address is not used and is discarded).
     auto [name, type] = split_watch_name(full_name);
 
     // Insert a new entry for this watch into the list. We must be inserting at the back and should get the watches in order.
+    // The list adds it to its parent's children, or the root's for a top-level item.
     assert(list.size() == index);
 
-    list.emplace_back(name, type, value, parent);
-
-    // If this has a parent, add this element to the parent's children list for easy access
-    if (parent >= 1)
-    {
-        list[parent].children.push_back(index);
-    }
-    else if (parent == -1)
-    {
-        // This is a top-level item, add it to root node's children list.
-        list[0].children.push_back(index);
-    }
+    list.add(std::move(name), std::move(type), value, parent);
 }
 
 void debugger_state::lock_list(watch_kind kind)
@@ -117,17 +240,29 @@ void debugger_state::unlock_list(watch_kind kind)
 {
     --watch_lock_depth_;
 
+    // The list is complete: pack its large arrays, then share its schema with any other list of the same
+    // shape, such as the same function's locals in another frame.
+    if (callstack_[current_frame_].frame->get_watches(kind).building())
+    {
+        watch_list& list = writable_watches(kind);
+        list.pack_arrays();
+        schemas_.intern(list);
+    }
+
     // If we have just unlocked the last watch list then we are done receiving watches. Signal
     // that they are available if the debugger is waiting for some watch list to complete.
     if (watch_lock_depth_ == 0)
     {
         if (state_ == state::waiting_for_frame_watches)
         {
-            signals::watches_received.fire();
+            writable_frame(current_frame_).fetched_watches = true;
+            publish();
+            fire_if_current(signals::watches_received);
         }
         else if (state_ == state::waiting_for_user_watches)
         {
-            signals::user_watches_received.fire();
+            publish();
+            fire_if_current(signals::user_watches_received);
         }
     }
 }
@@ -150,51 +285,96 @@ void debugger_state::clear_callstack()
     callstack_.resize(1);
 }
 
-void debugger_state::add_callstack(const std::string& full_name)
+// Split a call stack entry into its interned class and function names.
+std::pair<symbol, symbol> debugger_state::parse_callstack_entry(std::string_view full_name)
 {
     // Callstack entries are of the form "Kind ClassName:FunctionName" (for Kind == Function).
     // The "Kind" is not of any real use for the DAP so we just strip it. It's unclear yet if
     // there are kinds other than "Function".
+    //
+    // The entry is a view into the event's buffer: only the names we haven't seen before are copied.
 
     // Skip over the kind
-    std::string name = full_name;
+    std::string_view name = full_name;
 
     auto idx = name.find(' ');
-    if (idx >= 0)
+    if (idx != std::string_view::npos)
     {
-        std::string kind = name.substr(0, idx);
+        std::string_view kind = name.substr(0, idx);
         if (kind != "Function")
         {
-            log("Found unknown call stack kind %s\n", full_name.c_str());
+            log("Found unknown call stack kind %.*s\n", static_cast<int>(full_name.size()), full_name.data());
         }
-        name = name.substr(idx + 1);
+        name.remove_prefix(idx + 1);
     }
 
     idx = name.find(':');
 
-    std::string class_name = idx > 0 ? name.substr(0, idx) : name;
-    std::string function_name = idx > 0 ? name.substr(idx + 1) : "";
-    callstack_.emplace_back(class_name, function_name);
+    std::string_view class_name = idx != std::string_view::npos && idx > 0 ? name.substr(0, idx) : name;
+    std::string_view function_name = idx != std::string_view::npos && idx > 0 ? name.substr(idx + 1) : std::string_view{};
+    return { names_.intern(class_name), names_.intern(function_name) };
 }
 
-void debugger_state::set_current_frame_index(int frame)
+void debugger_state::add_frame(symbol class_name, symbol function_name)
 {
-    current_frame_ = frame;
+    // The new frame's watch lists are the shared empty list, so mark them published to have them
+    // copied before anything is written to them.
+    frame_slot& slot = callstack_.emplace_back(frame_slot{ std::make_shared<stack_frame>(class_name, function_name) });
+    std::fill(std::begin(slot.watches_published), std::end(slot.watches_published), true);
 }
 
-int debugger_state::get_current_frame_index() const
+void debugger_state::add_callstack(std::string_view full_name)
 {
-    return current_frame_;
+    auto [class_name, function_name] = parse_callstack_entry(full_name);
+    add_frame(class_name, function_name);
 }
 
-const stack_frame& debugger_state::get_current_stack_frame() const
+// Apply a call stack delta to the names of the last call stack, keeping the first 'prefix' entries and
+// adding the new ones after them. This must be done for every delta, even those for stops we're skipping,
+// so that the next one applies to the same stack the interface has.
+void debugger_state::apply_callstack_delta(int prefix, const std::vector<std::string_view>& entries)
 {
-    return callstack_[current_frame_];
+    stack_names_.resize(std::min<std::size_t>(std::max(prefix, 0), stack_names_.size()));
+    for (std::string_view entry : entries)
+    {
+        stack_names_.push_back(parse_callstack_entry(entry));
+    }
 }
 
-stack_frame& debugger_state::get_current_stack_frame()
+// Build the call stack from the names of the last call stack, as a call_stack_clear followed by a
+// call_stack_add for each entry would.
+//
+// Only the names carry over from the previous stop. Even when a frame's entry hasn't changed the
+// function may have returned and been called again since, so its line and watches have to be
+// fetched afresh.
+void debugger_state::build_callstack()
 {
-    return callstack_[current_frame_];
+    clear_callstack();
+    callstack_.reserve(stack_names_.size() + 1);
+    for (auto [class_name, function_name] : stack_names_)
+    {
+        add_frame(class_name, function_name);
+    }
+}
+
+void debugger_state::set_class_name(const std::string& class_name)
+{
+    writable_frame(current_frame_).class_name = names_.intern(class_name);
+}
+
+void debugger_state::set_line_number(int line)
+{
+    writable_frame(current_frame_).line_number = line;
+}
+
+void debugger_state::set_current_frame_index(int frame)
+{
+    current_frame_ = frame;
+}
+
+int debugger_state::get_current_frame_index() const
+{
+    return current_frame_;
 }
 
 // Unreal indexes the callstack with the top-most frame as id 0, and sends the frames
@@ -215,8 +395,10 @@ void debugger_state::finalize_callstack()
     // The bottom-most and top-most entries on the current call stack are the same entry, but
     // both are incomplete: only the bottom has the line number, and only the top has the function
     // name.
-    stack_frame& bottom_frame = *callstack_.begin();
-    stack_frame& top_frame = *callstack_.rbegin();
+    frame_slot& bottom_slot = callstack_.front();
+    frame_slot& top_slot = callstack_.back();
+    stack_frame& bottom_frame = writable_frame(0);
+    stack_frame& top_frame = writable_frame(static_cast<int>(callstack_.size()) - 1);
 
     // Copy the line number to the top-most frame.
     top_frame.line_number = bottom_frame.line_number;
@@ -224,6 +406,8 @@ void debugger_state::finalize_callstack()
     // Move the watch info to the top-most frame.
     std::swap(top_frame.local_watches, bottom_frame.local_watches);
     std::swap(top_frame.global_watches, bottom_frame.global_watches);
+    std::swap(top_slot.watches_published[static_cast<int>(watch_kind::local)], bottom_slot.watches_published[static_cast<int>(watch_kind::local)]);
+    std::swap(top_slot.watches_published[static_cast<int>(watch_kind::global)], bottom_slot.watches_published[static_cast<int>(watch_kind::global)]);
 
     // Reverse the call stack so our 0th index is the top-most entry
     std::reverse(callstack_.begin(), callstack_.end());
@@ -232,27 +416,29 @@ void debugger_state::finalize_callstack()
     // This leaves the stack with index 0 as the top-most entry, and with complete info.
     callstack_.pop_back();
 
-    callstack_[0].fetched_watches = true;
+    // The call stack is complete: let the handlers see it. The top frame's watches may still be to come.
+    publish();
+    set_stop_phase(stop_phase::stack_received);
 }
 
-int debugger_state::find_user_watch(int frame_index, const std::string& var_name) const
+// Everything about the stop has arrived, including the top frame's watches.
+void debugger_state::complete_stop()
 {
-    if (frame_index >= callstack_.size())
-    {
-        log("Error: Requested user watch %s for invalid frame %d\n", var_name.c_str(), frame_index);
-        return -1;
-    }
-
-    const watch_list& user_watches = callstack_[frame_index].user_watches;
+    writable_frame(0).fetched_watches = true;
+    publish();
+    set_stop_phase(stop_phase::complete);
+}
 
-    if (user_watches.empty() || user_watches[0].children.empty())
+int stack_frame::find_user_watch(const std::string& var_name) const
+{
+    if (user_watches->empty() || (*user_watches)[0].children.empty())
         return -1;
 
-    for (int i = 0; i < user_watches[0].children.size(); ++i)
+    for (int child : (*user_watches)[0].children)
     {
-        if (user_watches[user_watches[0].children[i]].name == var_name)
+        if ((*user_watches)[child].name == var_name)
         {
-            return user_watches[0].children[i];
+            return child;
         }
     }
 
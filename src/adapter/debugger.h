@@ -2,10 +2,22 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <string_view>
+
+#include "symbols.h"
+#include "watches.h"
 
 namespace unreal_debugger::client
 {
 
+namespace signals
+{
+    class signal;
+}
+
 enum class watch_kind
 {
     local,
@@ -13,44 +25,56 @@ enum class watch_kind
     user
 };
 
-// Watch lists
-struct watch_data
-{
-    watch_data(const std::string& n, const std::string& t, const std::string& v, int p) :
-        name(n), type(t), value(v), parent(p)
-    {}
-
-    std::string name;
-    std::string type;
-    std::string value;
-    int parent;
-    std::vector<int> children;
-};
-
-using watch_list = std::vector<watch_data>;
-
+// A frame of the call stack. Once published in a snapshot a frame is never modified. The watch
+// lists are held by pointer so that a frame that changes can share the lists that didn't with
+// the frame it replaces. Class and function names are interned in the debugger's symbol table, and
+// the schemas of the watch lists in its schema table.
 struct stack_frame
 {
-    stack_frame() = default;
-    stack_frame(const std::string& cls, const std::string& func) : class_name(cls), function_name(func)
-    {}
+    stack_frame();
+    stack_frame(symbol cls, symbol func);
 
     const watch_list& get_watches(watch_kind kind) const;
-    watch_list& get_watches(watch_kind kind);
+    std::shared_ptr<watch_list>& get_watches_ptr(watch_kind kind);
+
+    int find_user_watch(const std::string& var_name) const;
 
-    std::string class_name = "";
+    symbol class_name;
     int line_number = 0;
-    std::string function_name = "";
-    watch_list local_watches;
-    watch_list global_watches;
-    watch_list user_watches;
+    symbol function_name;
+    std::shared_ptr<watch_list> local_watches;
+    std::shared_ptr<watch_list> global_watches;
+    std::shared_ptr<watch_list> user_watches;
     bool fetched_watches = false;
 };
 
+// The state of the call stack at a stop, as seen by the DAP handlers.
+//
+// Events from the interface are applied on the IO thread while handlers read the call stack on
+// cppdap's threads. Rather than locking, the IO thread builds changes on its own private copy of
+// the call stack and then publishes a new snapshot for the handlers to read. A snapshot, and
+// every frame and watch list in it, is immutable once published, so a handler that has loaded a
+// snapshot can read it for as long as it likes without any coordination with the IO thread.
+// Publishing only copies the frame pointers: frames and watch lists that haven't changed are
+// shared with the previous snapshot.
+struct stop_snapshot
+{
+    std::vector<std::shared_ptr<const stack_frame>> frames;
+};
+
 class debugger_state
 {
 public:
 
+    // How much of the current stop Unreal has described. A stop is reported to the client as soon as
+    // it begins, so handlers may have to wait for the part of it they need.
+    enum class stop_phase
+    {
+        begun,
+        stack_received,
+        complete
+    };
+
     enum class state
     {
         normal,
@@ -62,10 +86,12 @@ public:
 
     debugger_state()
     {
-        // Ensure we always have one element in the call stack to represent the top-most frame.
-        callstack_.resize(1);
+        reset();
     }
 
+    // Return to the state of a freshly started adapter, for the start of a new session.
+    void reset();
+
     void clear_watch(watch_kind kind);
     void reserve_watch_size(watch_kind kind, std::size_t size);
     void add_watch(watch_kind kind, int index, int parent, const std::string& name, const std::string& value);
@@ -74,30 +100,100 @@ public:
     void unlock_list(watch_kind kind);
 
     void clear_callstack();
-    void add_callstack(const std::string& name);
+    void add_callstack(std::string_view name);
+    void apply_callstack_delta(int prefix, const std::vector<std::string_view>& entries);
+    void build_callstack();
+    void set_class_name(const std::string& class_name);
+    void set_line_number(int line);
     int get_current_frame_index() const;
     void set_current_frame_index(int frame);
-    const stack_frame& get_current_stack_frame() const;
-    stack_frame& get_current_stack_frame();
-    const stack_frame& get_stack_frame(int idx) const { return callstack_[idx]; }
-    size_t callstack_size() const { return callstack_.size(); }
+
+    // Publish the IO thread's call stack as the new snapshot. Must be called before signalling a
+    // handler that the information it is waiting for has arrived.
+    void publish();
+
+    // Handler access to the most recently published snapshot.
+    std::shared_ptr<const stop_snapshot> snapshot() const { return std::atomic_load(&snapshot_); }
+    // Null if there is no such frame, e.g. for a frame id the client got in an earlier stop.
+    std::shared_ptr<const stack_frame> get_stack_frame(int idx) const
+    {
+        std::shared_ptr<const stop_snapshot> s = snapshot();
+        return idx >= 0 && idx < static_cast<int>(s->frames.size()) ? s->frames[idx] : nullptr;
+    }
+    size_t callstack_size() const { return snapshot()->frames.size(); }
 
     void add_breakpoint(const std::string& class_name, int line);
     void remove_breakpoints(const std::string& class_name);
     const std::vector<int>* get_breakpoints(const std::string& class_name) const;
 
+    // Stops. The interface reports the start of a stop (stop_begin), then the call stack, then the top
+    // frame's watches. These move the stop through its phases. Called on the IO thread.
+    void begin_stop();
     void finalize_callstack();
+    void complete_stop();
+    stop_phase get_stop_phase() const { return stop_phase_; }
+
+    // Stop generations. Each stop, and each resume, starts a new generation. Work started for a
+    // stop is stale once the generation has moved on and should be dropped without finishing.
+    unsigned generation() const { return generation_; }
+
+    // The adapter is about to resume Unreal. Called before the resume command is sent.
+    void begin_resume();
+
+    // The interface has resumed Unreal ('resumed' event). Called on the IO thread.
+    void resumed();
+
+    // True on the IO thread while events from a stop the adapter has already resumed are still
+    // arriving. These are left unprocessed.
+    bool is_stale() const { return resumes_seen_ < resumes_requested_; }
+
+    // Fire a signal unless the stop it is for has been resumed in the meantime.
+    void fire_if_current(signals::signal& s);
+
     void set_state(state s) { state_ = s; }
     state get_state() const { return state_; }
-    int find_user_watch(int frame_index, const std::string& var_name) const;
 
 private:
 
-    std::vector<stack_frame> callstack_;
-    int current_frame_ = 0;
+    // The IO thread's call stack. A frame that has been published is shared with the snapshot
+    // and must be copied before it can be changed; the same goes for each of its watch lists.
+    struct frame_slot
+    {
+        std::shared_ptr<stack_frame> frame = std::make_shared<stack_frame>();
+        bool frame_published = false;
+        bool watches_published[3] = { false, false, false };
+    };
+
+    void set_stop_phase(stop_phase phase);
+    stack_frame& writable_frame(int idx);
+    watch_list& writable_watches(watch_kind kind);
+
+    std::pair<symbol, symbol> parse_callstack_entry(std::string_view full_name);
+    void add_frame(symbol class_name, symbol function_name);
+
+    // Interned class and function names for the session.
+    symbol_table names_;
+
+    // Shared watch list schemas for the session.
+    watch_schema_table schemas_;
+
+    std::vector<frame_slot> callstack_;
+
+    // The class and function names of the last call stack the interface sent, bottom-most first,
+    // for applying the next call stack delta to.
+    std::vector<std::pair<symbol, symbol>> stack_names_;
+    std::shared_ptr<const stop_snapshot> snapshot_;
+    std::atomic<int> current_frame_ = 0;
     std::atomic<state> state_;
+    std::atomic<stop_phase> stop_phase_;
     int watch_lock_depth_ = 0;
 
+    // Guards the generation against firing a signal for a stop that has just been resumed.
+    std::mutex generation_mutex_;
+    std::atomic<unsigned> generation_ = 0;
+    std::atomic<unsigned> resumes_requested_ = 0;
+    unsigned resumes_seen_ = 0;
+
     // A map from class name to a list of line numbers representing the breakpoints in this file.
     // Note that unreal provides breakpoint info with the class names in all uppercase, so this map
     // always contains upcased strings.
@@ -106,5 +202,19 @@ private:
 
 extern debugger_state debugger;
 
+// The stop generation a piece of work was started in.
+class stop_token
+{
+public:
+    stop_token() : generation_{ debugger.generation() }
+    {}
+
+    bool stale() const { return debugger.generation() != generation_; }
+    unsigned generation() const { return generation_; }
+
+private:
+    unsigned generation_;
+};
+
 }
 
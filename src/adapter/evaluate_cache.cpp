@@ -0,0 +1,65 @@
+#include "evaluate_cache.h"
+
+#include <boost/algorithm/string.hpp>
+
+namespace unreal_debugger::adapter
+{
+
+evaluate_cache evaluations;
+
+// UnrealScript names aren't case sensitive, and surrounding whitespace doesn't change what an
+// expression means, so "Foo", "foo" and " foo " share an entry.
+std::string evaluate_cache::make_key(int frame, const std::string& context, const std::string& expression)
+{
+    std::string key = std::to_string(frame);
+    key += '\0';
+    key += context;
+    key += '\0';
+    key += boost::algorithm::to_lower_copy(boost::algorithm::trim_copy(expression));
+    return key;
+}
+
+// Forget everything from earlier stops.
+void evaluate_cache::start_generation(unsigned generation)
+{
+    if (generation != generation_)
+    {
+        results_.clear();
+        order_.clear();
+        generation_ = generation;
+    }
+}
+
+std::optional<evaluate_cache::result> evaluate_cache::find(unsigned generation, int frame, const std::string& context, const std::string& expression)
+{
+    start_generation(generation);
+
+    auto it = results_.find(make_key(frame, context, expression));
+    if (it == results_.end())
+    {
+        return {};
+    }
+    return it->second;
+}
+
+void evaluate_cache::insert(unsigned generation, int frame, const std::string& context, const std::string& expression, const result& value)
+{
+    start_generation(generation);
+
+    std::string key = make_key(frame, context, expression);
+    if (results_.count(key))
+    {
+        return;
+    }
+
+    if (results_.size() >= max_entries)
+    {
+        results_.erase(order_.front());
+        order_.pop_front();
+    }
+
+    results_.emplace(key, value);
+    order_.push_back(std::move(key));
+}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <deque>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "dap/protocol.h"
+
+namespace unreal_debugger::adapter
+{
+
+// The results of evaluate requests for the current stop.
+//
+// VS Code sends a hover evaluate for an identifier every time the mouse passes over it, and each
+// evaluate that isn't already a user watch costs a round trip to Unreal to add one. Nothing can
+// change while Unreal is stopped, so the result of evaluating an expression in a frame holds for the
+// whole stop, failures included. Results are keyed by frame, context and expression, and the cache
+// empties itself as soon as it is used in a new stop.
+//
+// Only the request worker uses the cache, so it isn't locked.
+class evaluate_cache
+{
+public:
+    using result = dap::ResponseOrError<dap::EvaluateResponse>;
+
+    // The most results kept for a stop. Once full the oldest are dropped first.
+    static constexpr std::size_t max_entries = 256;
+
+    std::optional<result> find(unsigned generation, int frame, const std::string& context, const std::string& expression);
+    void insert(unsigned generation, int frame, const std::string& context, const std::string& expression, const result& value);
+
+private:
+    static std::string make_key(int frame, const std::string& context, const std::string& expression);
+    void start_generation(unsigned generation);
+
+    unsigned generation_ = 0;
+    std::unordered_map<std::string, result> results_;
+
+    // Keys in the order they were added, for dropping the oldest.
+    std::deque<std::string> order_;
+};
+
+extern evaluate_cache evaluations;
+
+}
@@ -12,9 +12,31 @@ namespace events = serialization::events;
 
 void show_dll_form(const events::show_dll_form& ev)
 {
- 
-    debugger.finalize_callstack();
-    // Tell the debugger we've hit a breakpoint.
+    // The stop is usually announced by stop_begin, and the call stack finalized when it arrives. Older
+    // interfaces send neither, and the whole stop is only known now.
+    bool announced = debugger.get_stop_phase() != debugger_state::stop_phase::complete;
+    if (!announced)
+    {
+        debugger.begin_stop();
+    }
+    if (debugger.get_stop_phase() == debugger_state::stop_phase::begun)
+    {
+        debugger.finalize_callstack();
+    }
+    debugger.complete_stop();
+
+    if (!announced)
+    {
+        // Tell the debugger we've hit a breakpoint.
+        adapter::breakpoint_hit();
+    }
+}
+
+void stop_begin(const events::stop_begin& ev)
+{
+    // Tell the debugger we've hit a breakpoint. It can start asking about the stop while Unreal is still
+    // describing it: handlers wait for what they need.
+    debugger.begin_stop();
     adapter::breakpoint_hit();
 }
 
@@ -69,12 +91,12 @@ void remove_breakpoint(const events::remove_breakpoint& ev)
 
 void editor_load_class(const events::editor_load_class& ev)
 {
-    debugger.get_current_stack_frame().class_name = ev.class_name_;
+    debugger.set_class_name(ev.class_name_);
 }
 
 void editor_goto_line(const events::editor_goto_line& ev)
 {
-    debugger.get_current_stack_frame().line_number = ev.line_number_;
+    debugger.set_line_number(ev.line_number_);
 }
 
 void add_line_to_log(const events::add_line_to_log& ev)
@@ -87,9 +109,26 @@ void call_stack_clear(const events::call_stack_clear& ev)
     debugger.clear_callstack();
 }
 
-void call_stack_add(const events::call_stack_add& ev)
+void call_stack_add(std::string_view entry)
 {
-    debugger.add_callstack(ev.entry_);
+    debugger.add_callstack(entry);
+}
+
+void call_stack_delta(const events::call_stack_delta::view& ev)
+{
+    // Unlike the other stop events a delta is applied even for a stop that has been resumed: the next
+    // delta is relative to this one. The stale stop's frames are just not built.
+    debugger.apply_callstack_delta(ev.prefix_, ev.entries_);
+    if (!debugger.is_stale())
+    {
+        debugger.build_callstack();
+
+        // The top frame's watches follow the call stack, so there's no need to wait for them to finish it.
+        if (debugger.get_stop_phase() == debugger_state::stop_phase::begun)
+        {
+            debugger.finalize_callstack();
+        }
+    }
 }
 
 void set_current_object_name(const events::set_current_object_name& ev)
@@ -99,7 +138,8 @@ void set_current_object_name(const events::set_current_object_name& ev)
     // This is because we've disabled watch info for this change.
     if (debugger.get_state() == debugger_state::state::waiting_for_frame_line)
     {
-        signals::line_received.fire();
+        debugger.publish();
+        debugger.fire_if_current(signals::line_received);
     }
 }
 
@@ -110,11 +150,44 @@ void terminated(const events::terminated& ev)
     adapter::debugger_terminated();
 }
 
-void dispatch_event(const serialization::message& msg)
+void resumed(const events::resumed& ev)
+{
+    debugger.resumed();
+}
+
+// Events describing the state of Unreal at a stop. call_stack_delta is not one of them: see call_stack_delta.
+static bool is_stop_event(events::event_kind k)
+{
+    switch (k)
+    {
+    case events::event_kind::stop_begin:
+    case events::event_kind::show_dll_form:
+    case events::event_kind::clear_a_watch:
+    case events::event_kind::lock_list:
+    case events::event_kind::unlock_list:
+    case events::event_kind::editor_load_class:
+    case events::event_kind::editor_goto_line:
+    case events::event_kind::call_stack_clear:
+    case events::event_kind::call_stack_add:
+    case events::event_kind::set_current_object_name:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void dispatch_event(const serialization::message_view& msg)
 {
-    char* buf = msg.buf_.get();
+    char* buf = msg.buf_;
     events::event_kind k = serialization::deserialize_event_kind(buf);
 
+    // Once the adapter has resumed Unreal, whatever is still arriving about the stop it left is of
+    // no use to anyone. Skip it without even deserializing it.
+    if (debugger.is_stale() && is_stop_event(k))
+    {
+        return;
+    }
+
     switch (k)
     {
     case events::event_kind::show_dll_form: show_dll_form(events::show_dll_form{ msg }); return;
@@ -130,9 +203,12 @@ void dispatch_event(const serialization::message& msg)
     case events::event_kind::editor_goto_line: editor_goto_line(events::editor_goto_line{ msg }); return;
     case events::event_kind::add_line_to_log: add_line_to_log(events::add_line_to_log{ msg }); return;
     case events::event_kind::call_stack_clear: call_stack_clear(events::call_stack_clear{ msg }); return;
-    case events::event_kind::call_stack_add: call_stack_add(events::call_stack_add{ msg }); return;
+    case events::event_kind::call_stack_add: call_stack_add(events::call_stack_add::entry_view(msg)); return;
     case events::event_kind::set_current_object_name: set_current_object_name(events::set_current_object_name{ msg }); return;
     case events::event_kind::terminated: terminated(events::terminated{ msg }); return;
+    case events::event_kind::resumed: resumed(events::resumed{ msg }); return;
+    case events::event_kind::call_stack_delta: call_stack_delta(events::call_stack_delta::view{ msg }); return;
+    case events::event_kind::stop_begin: stop_begin(events::stop_begin{ msg }); return;
     }
 
     throw std::runtime_error("Unexpected event type");
@@ -0,0 +1,341 @@
+#include "log_capture.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace unreal_debugger::adapter
+{
+
+namespace fs = std::filesystem;
+namespace ipc = boost::interprocess;
+
+log_capture game_log;
+console_throttle console_limit;
+
+// The most segments a capture may have. Beyond this (1 GB) lines are no longer captured.
+static constexpr std::size_t max_segments = 64;
+
+// Log text is matched without regard to case. Only ASCII letters are folded: the log is in the game's
+// character set, which isn't known here.
+static char fold(char c)
+{
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+static std::string fold_copy(std::string_view text)
+{
+    std::string folded(text);
+    std::transform(folded.begin(), folded.end(), folded.begin(), fold);
+    return folded;
+}
+
+// Does 'text' contain 'needle', which has already been folded?
+static bool contains_folded(std::string_view text, const std::string& needle)
+{
+    return std::search(text.begin(), text.end(), needle.begin(), needle.end(), [](char a, char b) { return fold(a) == b; }) != text.end();
+}
+
+// Segment files are named by number. Only files named like that are removed from the capture directory,
+// whatever else is in it.
+static bool is_segment_name(const fs::path& name)
+{
+    std::string str = name.string();
+    return str.size() == 8 && str.compare(4, 4, ".log") == 0 && std::all_of(str.begin(), str.begin() + 4, [](char c) { return c >= '0' && c <= '9'; });
+}
+
+bool log_capture::open(const fs::path& dir)
+{
+    close();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec)
+    {
+        return false;
+    }
+
+    for (const fs::directory_entry& file : fs::directory_iterator(dir, ec))
+    {
+        if (is_segment_name(file.path().filename()))
+        {
+            fs::remove(file.path(), ec);
+        }
+    }
+
+    dir_ = dir;
+    open_ = add_segment();
+    return open_;
+}
+
+void log_capture::close()
+{
+    // The segments are released outside the lock: trimming them touches the disk.
+    std::vector<std::shared_ptr<segment>> segments;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        open_ = false;
+        segments.swap(segments_);
+        blocks_.clear();
+        count_ = 0;
+        last_time_ = 0;
+    }
+}
+
+// Trim the unwritten space from the end of the file, so it is plain text. This must wait until the file is
+// no longer mapped: shrinking a file under a mapping that is still being read faults the reader on POSIX,
+// and fails on Windows. Segments are shared with the searches reading them, so the last one to let go of
+// it does the trim.
+log_capture::segment::~segment()
+{
+    region = ipc::mapped_region();
+    file = ipc::file_mapping();
+
+    std::error_code ec;
+    fs::resize_file(path, used, ec);
+}
+
+// Start a new segment file and map it. Called with the lock held.
+bool log_capture::add_segment()
+{
+    if (segments_.size() >= max_segments)
+    {
+        return false;
+    }
+
+    char name[16];
+    snprintf(name, sizeof(name), "%04zu.log", segments_.size());
+
+    auto s = std::make_shared<segment>();
+    s->path = dir_ / name;
+
+    try
+    {
+        {
+            std::ofstream file(s->path, std::ios::binary | std::ios::trunc);
+            if (!file)
+            {
+                return false;
+            }
+        }
+        fs::resize_file(s->path, segment_size);
+        s->file = ipc::file_mapping(s->path.string().c_str(), ipc::read_write);
+        s->region = ipc::mapped_region(s->file, ipc::read_write);
+    }
+    catch (const ipc::interprocess_exception&)
+    {
+        return false;
+    }
+    catch (const fs::filesystem_error&)
+    {
+        return false;
+    }
+
+    segments_.push_back(std::move(s));
+    return true;
+}
+
+void log_capture::append(std::string_view text)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_)
+    {
+        return;
+    }
+
+    // Lines never span segments. Each is followed by a newline in the file.
+    std::size_t length = std::min(text.size(), segment_size - 1);
+    text = text.substr(0, length);
+
+    if (segments_.back()->used + length + 1 > segment_size && !add_segment())
+    {
+        // Out of space: keep what has been captured so far, but no more.
+        open_ = false;
+        return;
+    }
+
+    segment& s = *segments_.back();
+    memcpy(s.data() + s.used, text.data(), length);
+    s.data()[s.used + length] = '\n';
+
+    if (count_ % lines_per_block == 0)
+    {
+        blocks_.push_back(std::make_shared<block>());
+    }
+
+    // Times only go forward, so a search can find a time by bisection even if the clock is set back.
+    std::int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    last_time_ = std::max(last_time_, now);
+
+    block& b = *blocks_.back();
+    b.lines[count_ % lines_per_block] = entry{ static_cast<std::uint32_t>(segments_.size() - 1), static_cast<std::uint32_t>(s.used), static_cast<std::uint32_t>(length), last_time_ };
+    add_to_bloom(b, text);
+
+    s.used += length + 1;
+    ++count_;
+}
+
+std::uint64_t log_capture::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return count_;
+}
+
+std::uint32_t log_capture::trigram_hash(const char* p)
+{
+    std::uint32_t v = static_cast<unsigned char>(fold(p[0]))
+        | static_cast<unsigned char>(fold(p[1])) << 8
+        | static_cast<unsigned char>(fold(p[2])) << 16;
+    return v * 2654435761u;
+}
+
+// Each trigram sets two bits of the block's filter, one from each half of its hash.
+void log_capture::add_to_bloom(block& b, std::string_view text)
+{
+    for (std::size_t i = 0; i + 3 <= text.size(); ++i)
+    {
+        std::uint32_t h = trigram_hash(text.data() + i);
+        std::uint32_t bit1 = h % bloom_bits;
+        std::uint32_t bit2 = (h >> 16) % bloom_bits;
+        b.bloom[bit1 / 64] |= std::uint64_t{ 1 } << (bit1 % 64);
+        b.bloom[bit2 / 64] |= std::uint64_t{ 1 } << (bit2 % 64);
+    }
+}
+
+bool log_capture::may_contain(const block& b, const std::vector<std::uint32_t>& trigrams)
+{
+    for (std::uint32_t h : trigrams)
+    {
+        std::uint32_t bit1 = h % bloom_bits;
+        std::uint32_t bit2 = (h >> 16) % bloom_bits;
+        if (!(b.bloom[bit1 / 64] & (std::uint64_t{ 1 } << (bit1 % 64))) || !(b.bloom[bit2 / 64] & (std::uint64_t{ 1 } << (bit2 % 64))))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<log_capture::line> log_capture::search(const query& q, bool& truncated) const
+{
+    // Everything up to the current count is complete and won't change, so it can be read without the lock.
+    std::vector<std::shared_ptr<segment>> segments;
+    std::vector<std::shared_ptr<block>> blocks;
+    std::uint64_t count;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        segments = segments_;
+        blocks = blocks_;
+        count = count_;
+    }
+
+    auto entry_at = [&](std::uint64_t n) -> const entry& { return blocks[n / lines_per_block]->lines[n % lines_per_block]; };
+
+    // Find the first line in the time range.
+    std::uint64_t first = std::min(q.first_line, count);
+    if (q.start_time)
+    {
+        std::uint64_t lo = first;
+        std::uint64_t hi = count;
+        while (lo < hi)
+        {
+            std::uint64_t mid = lo + (hi - lo) / 2;
+            if (entry_at(mid).time < *q.start_time)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        first = lo;
+    }
+
+    std::string needle = fold_copy(q.text);
+    std::vector<std::uint32_t> trigrams;
+    for (std::size_t i = 0; i + 3 <= needle.size(); ++i)
+    {
+        trigrams.push_back(trigram_hash(needle.data() + i));
+    }
+
+    // The last block may still be being filled, so its filter isn't used.
+    std::uint64_t full_blocks = count / lines_per_block;
+
+    truncated = false;
+    std::vector<line> results;
+    for (std::uint64_t n = first; n < count;)
+    {
+        const entry& e = entry_at(n);
+        if (q.end_time && e.time > *q.end_time)
+        {
+            break;
+        }
+
+        std::uint64_t b = n / lines_per_block;
+        if (!trigrams.empty() && b < full_blocks && !may_contain(*blocks[b], trigrams))
+        {
+            n = (b + 1) * lines_per_block;
+            continue;
+        }
+
+        std::string_view text(segments[e.segment]->data() + e.offset, e.length);
+        if (needle.empty() || contains_folded(text, needle))
+        {
+            if (results.size() >= q.max_results)
+            {
+                truncated = true;
+                break;
+            }
+            results.push_back(line{ n, e.time, std::string(text) });
+        }
+        ++n;
+    }
+    return results;
+}
+
+void console_throttle::configure(int lines_per_second, const std::string& filter)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    lines_per_second_ = std::max(lines_per_second, 0);
+    filter_ = fold_copy(filter);
+    tokens_ = lines_per_second_;
+    last_refill_ = std::chrono::steady_clock::now();
+    held_back_ = 0;
+}
+
+bool console_throttle::allow(std::string_view text, std::uint64_t& held_back)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Lines that don't match the filter aren't wanted at all, so they aren't counted as held back.
+    if (!filter_.empty() && !contains_folded(text, filter_))
+    {
+        return false;
+    }
+
+    // Up to a second's worth of lines can go at once, after which they go at the set rate.
+    if (lines_per_second_ > 0)
+    {
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - last_refill_).count();
+        tokens_ = std::min<double>(lines_per_second_, tokens_ + elapsed * lines_per_second_);
+        last_refill_ = now;
+
+        if (tokens_ < 1)
+        {
+            ++held_back_;
+            return false;
+        }
+        tokens_ -= 1;
+    }
+
+    held_back = held_back_;
+    held_back_ = 0;
+    return true;
+}
+
+}
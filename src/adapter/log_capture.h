@@ -0,0 +1,159 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace unreal_debugger::adapter
+{
+
+// A capture of every line of the game's log for the session, which can be searched.
+//
+// A busy game can log thousands of lines a second, far more than the editor's debug console can show
+// usefully. Every line is kept here instead, and only some of them go to the console (see
+// console_throttle).
+//
+// The text of the lines is appended to memory-mapped files in the capture directory, 16 MB at a time
+// ("0000.log", "0001.log", ...), so the capture lives in the file cache rather than the adapter's own
+// memory, and the files can be read as plain text. An index of the lines is kept in memory in blocks of
+// 1024 lines: where each line is and when it was logged. Each full block also has a bloom filter of the
+// trigrams in its lines, so a search for some text can skip every block that can't contain it.
+//
+// Lines are appended on the IO thread and searched on cppdap's threads. Nothing that has been appended
+// ever changes, so a search only takes the lock to see how much there is and then reads without it.
+class log_capture
+{
+public:
+    static constexpr std::size_t segment_size = 16 * 1024 * 1024;
+    static constexpr std::size_t lines_per_block = 1024;
+    static constexpr std::size_t bloom_bits = 32 * 1024;
+
+    // A line found by a search.
+    struct line
+    {
+        std::uint64_t number;
+
+        // When the line was logged, in milliseconds since the Unix epoch.
+        std::int64_t time;
+
+        std::string text;
+    };
+
+    struct query
+    {
+        // Text the lines must contain, ignoring case. Empty to match every line.
+        std::string text;
+
+        // Only lines logged in this time range, in milliseconds since the Unix epoch.
+        std::optional<std::int64_t> start_time;
+        std::optional<std::int64_t> end_time;
+
+        // The first line to consider, for continuing a search.
+        std::uint64_t first_line = 0;
+
+        std::size_t max_results = 1000;
+    };
+
+    // Start capturing to the given directory, replacing any earlier capture in it. Returns false if the
+    // capture can't be written, in which case lines are not kept.
+    bool open(const std::filesystem::path& dir);
+
+    // Stop capturing. The files are left behind, and each is trimmed to what was written once no search
+    // is reading it.
+    void close();
+
+    // Add a line. Does nothing if the capture isn't open.
+    void append(std::string_view text);
+
+    // The number of lines captured.
+    std::uint64_t size() const;
+
+    // Find lines matching a query, in order. 'truncated' is set if there were more than the query's
+    // maximum.
+    std::vector<line> search(const query& q, bool& truncated) const;
+
+private:
+    struct entry
+    {
+        std::uint32_t segment;
+        std::uint32_t offset;
+        std::uint32_t length;
+        std::int64_t time;
+    };
+
+    struct block
+    {
+        std::array<entry, lines_per_block> lines;
+        std::array<std::uint64_t, bloom_bits / 64> bloom{};
+    };
+
+    // A segment's file is trimmed to what was written once the last reference to it goes.
+    struct segment
+    {
+        ~segment();
+
+        std::filesystem::path path;
+        boost::interprocess::file_mapping file;
+        boost::interprocess::mapped_region region;
+        std::size_t used = 0;
+
+        char* data() const { return static_cast<char*>(region.get_address()); }
+    };
+
+    bool add_segment();
+
+    static std::uint32_t trigram_hash(const char* p);
+    static void add_to_bloom(block& b, std::string_view text);
+    static bool may_contain(const block& b, const std::vector<std::uint32_t>& trigrams);
+
+    mutable std::mutex mutex_;
+    std::filesystem::path dir_;
+    bool open_ = false;
+
+    // Segments and blocks are only ever added while the capture is open. A search holds references to
+    // the ones it reads so they outlive a close.
+    std::vector<std::shared_ptr<segment>> segments_;
+    std::vector<std::shared_ptr<block>> blocks_;
+    std::uint64_t count_ = 0;
+    std::int64_t last_time_ = 0;
+};
+
+extern log_capture game_log;
+
+// Decides which lines of the game log go to the debug console: those that contain the filter text (if
+// there is one), at no more than a set number of lines a second. The rest are only in the log capture.
+// When lines have been held back the console is told how many before the next line it gets.
+class console_throttle
+{
+public:
+    static constexpr int default_lines_per_second = 200;
+
+    // Set the limit, 0 for no limit, and the filter text, empty for no filter.
+    void configure(int lines_per_second, const std::string& filter);
+
+    // Should the line go to the console? If so, 'held_back' is set to the number of lines held back by the
+    // limit since the last line that went.
+    bool allow(std::string_view text, std::uint64_t& held_back);
+
+private:
+    std::mutex mutex_;
+    int lines_per_second_ = default_lines_per_second;
+    std::string filter_;
+    double tokens_ = default_lines_per_second;
+    std::chrono::steady_clock::time_point last_refill_ = std::chrono::steady_clock::now();
+    std::uint64_t held_back_ = 0;
+};
+
+extern console_throttle console_limit;
+
+}
@@ -0,0 +1,210 @@
+
+#include "output.h"
+
+namespace unreal_debugger::adapter
+{
+
+output_thread output;
+
+void output_thread::start(console_sink send_console)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_)
+        return;
+
+    send_console_ = std::move(send_console);
+    running_ = true;
+    thread_ = std::thread([this] { run(); });
+}
+
+void output_thread::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_)
+            return;
+
+        running_ = false;
+    }
+
+    cv_.notify_all();
+    thread_.join();
+}
+
+void output_thread::post(std::function<void()> send)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_)
+            return;
+
+        items_.push_back(item{ std::move(send), {} });
+    }
+
+    cv_.notify_all();
+}
+
+void output_thread::post_console(const std::string& line)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_)
+            return;
+
+        // If console output is already waiting at the back of the queue, add to it rather than
+        // sending another event.
+        if (!items_.empty() && !items_.back().send && items_.back().console.size() < max_console_merge)
+        {
+            items_.back().console += line;
+            return;
+        }
+
+        items_.push_back(item{ {}, line });
+    }
+
+    cv_.notify_all();
+}
+
+void output_thread::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        cv_.wait(lock, [this] { return !items_.empty() || !running_; });
+
+        // Send whatever is queued, even once stopped, so nothing raised before the stop is lost.
+        if (items_.empty())
+            return;
+
+        std::deque<item> items;
+        std::swap(items, items_);
+        lock.unlock();
+
+        for (item& i : items)
+        {
+            if (i.send)
+            {
+                i.send();
+            }
+            else
+            {
+                send_console_(i.console);
+            }
+        }
+
+        lock.lock();
+    }
+}
+
+buffered_writer::buffered_writer(std::shared_ptr<dap::Writer> target) :
+    state_{ std::make_shared<shared_state>() }
+{
+    state_->target = std::move(target);
+    thread_ = std::thread(&buffered_writer::run, state_);
+}
+
+buffered_writer::~buffered_writer()
+{
+    close();
+}
+
+bool buffered_writer::isOpen()
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return !state_->closed && !state_->failed && state_->target->isOpen();
+}
+
+void buffered_writer::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (state_->closed)
+            return;
+
+        state_->closed = true;
+    }
+
+    state_->cv.notify_all();
+    if (wait_finished())
+    {
+        thread_.join();
+        state_->target->close();
+        return;
+    }
+
+    // The thread is stuck writing to a client that isn't reading. Closing the target fails the write
+    // for most targets; if it doesn't, the thread is left to finish whenever the write does.
+    state_->target->close();
+    if (wait_finished())
+    {
+        thread_.join();
+    }
+    else
+    {
+        thread_.detach();
+    }
+}
+
+bool buffered_writer::wait_finished()
+{
+    std::unique_lock<std::mutex> lock(state_->mutex);
+    return state_->cv.wait_for(lock, close_timeout, [this] { return state_->finished; });
+}
+
+bool buffered_writer::write(const void* buffer, std::size_t bytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (state_->closed || state_->failed)
+            return false;
+
+        if (state_->pending.size() + bytes > max_pending)
+        {
+            state_->failed = true;
+            state_->pending.clear();
+            state_->pending.shrink_to_fit();
+            return false;
+        }
+
+        const char* data = static_cast<const char*>(buffer);
+        state_->pending.insert(state_->pending.end(), data, data + bytes);
+    }
+
+    state_->cv.notify_all();
+    return true;
+}
+
+void buffered_writer::run(std::shared_ptr<shared_state> state)
+{
+    std::vector<char> writing;
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    for (;;)
+    {
+        state->cv.wait(lock, [&] { return !state->pending.empty() || state->closed; });
+
+        if (state->pending.empty())
+            break;
+
+        // Take everything written so far. The old buffer is reused for the next batch so
+        // it doesn't need to be regrown.
+        writing.clear();
+        std::swap(writing, state->pending);
+        lock.unlock();
+
+        bool ok = state->target->write(writing.data(), writing.size());
+
+        lock.lock();
+        if (!ok)
+        {
+            state->failed = true;
+            state->pending.clear();
+            break;
+        }
+    }
+
+    state->finished = true;
+    state->cv.notify_all();
+}
+
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dap/io.h"
+
+namespace unreal_debugger::adapter
+{
+
+// Sends events to the client on a thread of its own.
+//
+// Events are raised on the IO thread as Unreal's events arrive. Encoding them and writing them
+// out is left to the output thread so that a client that is slow to read can't hold up reading
+// from the interface. Console output arrives a line at a time, often in bursts, so consecutive
+// lines still waiting to be sent are merged into a single output event.
+class output_thread
+{
+public:
+    using console_sink = std::function<void(const std::string&)>;
+
+    // Start the thread. Merged console output is passed to 'send_console'.
+    void start(console_sink send_console);
+
+    // Send everything still queued and stop the thread.
+    void stop();
+
+    // Queue a function that sends an event.
+    void post(std::function<void()> send);
+
+    // Queue a line of console output.
+    void post_console(const std::string& line);
+
+private:
+    void run();
+
+    struct item
+    {
+        // Either a function to send an event, or (if empty) console text.
+        std::function<void()> send;
+        std::string console;
+    };
+
+    // The largest console text merged into a single event.
+    static constexpr std::size_t max_console_merge = 64 * 1024;
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<item> items_;
+    console_sink send_console_;
+    bool running_ = false;
+};
+
+extern output_thread output;
+
+// A writer that collects everything written to it in memory, and writes it through to another
+// writer on a thread of its own in as few large writes as possible. Nothing written to it blocks
+// on the client reading it.
+class buffered_writer : public dap::Writer
+{
+public:
+    // The most data held waiting for the client. A client this far behind has stopped reading, and
+    // the writer fails rather than grow without bound. Messages are written in pieces, so dropping
+    // some of them would only garble the stream.
+    static constexpr std::size_t max_pending = 64 * 1024 * 1024;
+
+    // How long close() gives the thread to write out what is left before giving up on the client.
+    static constexpr std::chrono::seconds close_timeout{ 2 };
+
+    explicit buffered_writer(std::shared_ptr<dap::Writer> target);
+    ~buffered_writer();
+
+    bool isOpen() override;
+
+    // Write out everything already written and close the target. If the client isn't reading, the
+    // target is closed under the thread's write, and the thread is left to finish on its own if even
+    // that doesn't free it.
+    void close() override;
+
+    bool write(const void* buffer, std::size_t bytes) override;
+
+private:
+    // The state shared with the thread. The thread holds it too, so it can outlive the writer.
+    struct shared_state
+    {
+        std::shared_ptr<dap::Writer> target;
+        std::mutex mutex;
+        std::condition_variable cv;
+
+        // Data waiting to be written. The thread swaps this with its own buffer and writes it
+        // without holding the lock.
+        std::vector<char> pending;
+        bool closed = false;
+        bool failed = false;
+
+        // Set when the thread has nothing more to do.
+        bool finished = false;
+    };
+
+    static void run(std::shared_ptr<shared_state> state);
+
+    // Wait for the thread to finish, for at most 'close_timeout'.
+    bool wait_finished();
+
+    std::shared_ptr<shared_state> state_;
+    std::thread thread_;
+};
+
+}
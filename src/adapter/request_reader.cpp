@@ -0,0 +1,236 @@
+#include "request_reader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+
+namespace unreal_debugger::adapter
+{
+
+request_seqs requests;
+
+void request_seqs::add(std::int64_t seq, std::string command)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_.size() >= max_pending)
+    {
+        pending_.pop_front();
+    }
+    pending_.emplace_back(seq, std::move(command));
+}
+
+std::optional<std::int64_t> request_seqs::claim(const std::string& command)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find_if(pending_.begin(), pending_.end(), [&](const auto& request) { return request.second == command; });
+    if (it == pending_.end())
+    {
+        return {};
+    }
+
+    std::int64_t seq = it->first;
+    pending_.erase(pending_.begin(), it + 1);
+    return seq;
+}
+
+void request_seqs::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.clear();
+}
+
+// Skip a JSON string starting at the quote at 'pos'. Returns the position after the closing quote, or npos
+// if the string isn't closed.
+static std::size_t skip_string(std::string_view json, std::size_t pos)
+{
+    for (++pos; pos < json.size(); ++pos)
+    {
+        if (json[pos] == '\\')
+        {
+            ++pos;
+        }
+        else if (json[pos] == '"')
+        {
+            return pos + 1;
+        }
+    }
+    return std::string_view::npos;
+}
+
+// Skip the JSON value starting at 'pos', without parsing it. Returns the position after it, or npos if it
+// isn't complete.
+static std::size_t skip_value(std::string_view json, std::size_t pos)
+{
+    int depth = 0;
+    while (pos < json.size())
+    {
+        char c = json[pos];
+        if (c == '"')
+        {
+            pos = skip_string(json, pos);
+            if (depth == 0)
+            {
+                return pos;
+            }
+            continue;
+        }
+
+        if (c == '{' || c == '[')
+        {
+            ++depth;
+        }
+        else if (c == '}' || c == ']')
+        {
+            // At depth 0 this closes the enclosing object, which ends a number or literal.
+            if (depth == 0)
+            {
+                return pos;
+            }
+            if (--depth == 0)
+            {
+                return pos + 1;
+            }
+        }
+        else if (c == ',' && depth == 0)
+        {
+            return pos;
+        }
+        ++pos;
+    }
+    return std::string_view::npos;
+}
+
+static std::size_t skip_space(std::string_view json, std::size_t pos)
+{
+    while (pos < json.size() && (json[pos] == ' ' || json[pos] == '\t' || json[pos] == '\r' || json[pos] == '\n'))
+    {
+        ++pos;
+    }
+    return pos;
+}
+
+request_reader::request_reader(std::shared_ptr<dap::Reader> source) :
+    source_{ std::move(source) }
+{}
+
+bool request_reader::isOpen()
+{
+    return source_->isOpen();
+}
+
+void request_reader::close()
+{
+    source_->close();
+}
+
+std::size_t request_reader::read(void* buffer, std::size_t bytes)
+{
+    std::size_t n = source_->read(buffer, bytes);
+    scan(static_cast<const char*>(buffer), n);
+    return n;
+}
+
+void request_reader::scan(const char* data, std::size_t size)
+{
+    while (size > 0)
+    {
+        if (content_remaining_ == 0)
+        {
+            header_ += *data++;
+            --size;
+
+            if (header_.size() >= 4 && header_.compare(header_.size() - 4, 4, "\r\n\r\n") == 0)
+            {
+                std::size_t pos = header_.find("Content-Length:");
+                if (pos != std::string::npos)
+                {
+                    content_remaining_ = std::strtoul(header_.c_str() + pos + 15, nullptr, 10);
+                    content_.clear();
+                }
+                header_.clear();
+            }
+            else if (header_.size() > max_header)
+            {
+                header_.clear();
+            }
+            continue;
+        }
+
+        std::size_t n = std::min(size, content_remaining_);
+        content_.append(data, n);
+        data += n;
+        size -= n;
+        content_remaining_ -= n;
+
+        if (content_remaining_ == 0)
+        {
+            scan_message(content_);
+        }
+    }
+}
+
+// Find the members of a message that say whether it is a request, and which one. Only the members of the
+// top-level object are looked at: the values of the others (such as a request's arguments) are skipped.
+void request_reader::scan_message(std::string_view json)
+{
+    std::optional<std::int64_t> seq;
+    std::string_view type;
+    std::string_view command;
+
+    std::size_t pos = skip_space(json, 0);
+    if (pos >= json.size() || json[pos] != '{')
+    {
+        return;
+    }
+    pos = skip_space(json, pos + 1);
+
+    while (pos < json.size() && json[pos] == '"')
+    {
+        std::size_t key_end = skip_string(json, pos);
+        if (key_end == std::string_view::npos)
+        {
+            return;
+        }
+        std::string_view key = json.substr(pos + 1, key_end - pos - 2);
+
+        pos = skip_space(json, key_end);
+        if (pos >= json.size() || json[pos] != ':')
+        {
+            return;
+        }
+        pos = skip_space(json, pos + 1);
+
+        std::size_t value_end = skip_value(json, pos);
+        if (value_end == std::string_view::npos)
+        {
+            return;
+        }
+        std::string_view value = json.substr(pos, value_end - pos);
+
+        if (key == "seq")
+        {
+            std::int64_t n;
+            if (auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), n); ec == std::errc{})
+            {
+                seq = n;
+            }
+        }
+        else if ((key == "type" || key == "command") && value.size() >= 2 && value.front() == '"')
+        {
+            (key == "type" ? type : command) = value.substr(1, value.size() - 2);
+        }
+
+        pos = skip_space(json, value_end);
+        if (pos < json.size() && json[pos] == ',')
+        {
+            pos = skip_space(json, pos + 1);
+        }
+    }
+
+    if (type == "request" && seq && !command.empty())
+    {
+        requests.add(*seq, std::string{ command });
+    }
+}
+
+}
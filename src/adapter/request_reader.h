@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "dap/io.h"
+
+namespace unreal_debugger::adapter
+{
+
+// The seqs of the requests the client has sent, for their handlers to claim.
+//
+// cppdap doesn't tell a handler the seq of the request it is handling, which a 'cancel' request names.
+// But it dispatches requests one at a time in the order they were read, so when a handler runs, the
+// oldest unclaimed request with its command is the one it is handling. Requests before that one have
+// already been handled by handlers that didn't claim them.
+class request_seqs
+{
+public:
+    // Note a request as it is read. Called on cppdap's reading thread.
+    void add(std::int64_t seq, std::string command);
+
+    // Claim the seq of the request being dispatched, or nothing if it wasn't seen. Called on cppdap's
+    // dispatch thread.
+    std::optional<std::int64_t> claim(const std::string& command);
+
+    void clear();
+
+private:
+    // The most requests kept. Requests nothing claims would otherwise pile up until one of the claimed
+    // kind came along to clear them out.
+    static constexpr std::size_t max_pending = 1024;
+
+    std::mutex mutex_;
+    std::deque<std::pair<std::int64_t, std::string>> pending_;
+};
+
+extern request_seqs requests;
+
+// A reader that passes the client's messages through to cppdap unchanged, noting the seq and command of
+// each request in 'requests' on the way.
+class request_reader : public dap::Reader
+{
+public:
+    explicit request_reader(std::shared_ptr<dap::Reader> source);
+
+    bool isOpen() override;
+    void close() override;
+    std::size_t read(void* buffer, std::size_t bytes) override;
+
+private:
+    // Follow the messages through the bytes read: a header giving the content length, then the content.
+    void scan(const char* data, std::size_t size);
+    void scan_message(std::string_view json);
+
+    // Headers are a line or two. Anything longer isn't one.
+    static constexpr std::size_t max_header = 1024;
+
+    std::shared_ptr<dap::Reader> source_;
+    std::string header_;
+    std::string content_;
+    std::size_t content_remaining_ = 0;
+};
+
+}
@@ -0,0 +1,120 @@
+
+#include "request_worker.h"
+
+namespace unreal_debugger::adapter
+{
+
+request_worker worker;
+
+void request_worker::start()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_)
+        return;
+
+    running_ = true;
+    thread_ = std::thread([this] { run(); });
+}
+
+void request_worker::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_)
+            return;
+
+        running_ = false;
+        for (queued_job& j : jobs_)
+        {
+            *j.cancelled = true;
+        }
+        if (current_)
+        {
+            *current_ = true;
+        }
+    }
+
+    cv_.notify_all();
+    thread_.join();
+}
+
+void request_worker::post(job j, std::optional<std::int64_t> seq)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_)
+            return;
+
+        jobs_.push_back(queued_job{ std::make_shared<std::atomic<bool>>(false), seq, std::move(j) });
+    }
+
+    cv_.notify_all();
+}
+
+bool request_worker::cancel(std::int64_t seq)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_ && current_seq_ == seq)
+    {
+        *current_ = true;
+        return true;
+    }
+
+    for (queued_job& j : jobs_)
+    {
+        if (j.seq == seq)
+        {
+            *j.cancelled = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void request_worker::cancel_all()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (queued_job& j : jobs_)
+    {
+        *j.cancelled = true;
+    }
+    if (current_)
+    {
+        *current_ = true;
+    }
+}
+
+void request_worker::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return jobs_.empty() && !current_; });
+}
+
+void request_worker::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        cv_.wait(lock, [this] { return !jobs_.empty() || !running_; });
+
+        // Once stopped, the remaining jobs are still run: they have all been cancelled, so they
+        // finish straight away, and each one still gets to respond.
+        if (jobs_.empty())
+            return;
+
+        queued_job j = std::move(jobs_.front());
+        jobs_.pop_front();
+        current_ = j.cancelled;
+        current_seq_ = j.seq;
+
+        lock.unlock();
+        j.run(j.cancelled);
+        lock.lock();
+
+        current_.reset();
+        current_seq_.reset();
+        cv_.notify_all();
+    }
+}
+
+}
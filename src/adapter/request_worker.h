@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace unreal_debugger::adapter
+{
+
+// A flag set when the request holding it has been cancelled.
+using cancel_token = std::shared_ptr<const std::atomic<bool>>;
+
+// Runs requests that have to talk to Unreal one at a time, on a thread of its own.
+//
+// cppdap dispatches requests one at a time on a single thread, so a handler that blocks waiting
+// on Unreal (e.g. a stack trace visiting every frame) holds up every request behind it,
+// including a request to cancel it. Handlers that may take a while are queued here instead, and
+// respond when they finish, which leaves the dispatch thread free to receive a cancel, or a
+// continue or step that makes them pointless.
+//
+// Each job is given a token that is set if it is cancelled. Jobs are expected to check it at
+// convenient points and finish early, leaving Unreal in the state they found it.
+class request_worker
+{
+public:
+    using job = std::function<void(const cancel_token&)>;
+
+    void start();
+
+    // Cancel everything and wait for the thread to finish. Jobs posted after this are dropped.
+    void stop();
+
+    // Queue a job. 'seq' is the seq of the request it answers, if known, for cancelling it.
+    void post(job j, std::optional<std::int64_t> seq = {});
+
+    // Cancel the job answering the request with the given seq, if it is queued or running. Returns
+    // false if there is no such job.
+    bool cancel(std::int64_t seq);
+
+    // Cancel the running job and every queued job.
+    void cancel_all();
+
+    // Wait until there are no jobs queued or running.
+    void wait_idle();
+
+private:
+    void run();
+
+    using flag = std::shared_ptr<std::atomic<bool>>;
+
+    struct queued_job
+    {
+        flag cancelled;
+        std::optional<std::int64_t> seq;
+        job run;
+    };
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<queued_job> jobs_;
+    flag current_;
+    std::optional<std::int64_t> current_seq_;
+    bool running_ = false;
+};
+
+extern request_worker worker;
+
+}
@@ -7,9 +7,26 @@ namespace unreal_debugger::client::signals
         void wait()
         {
             std::unique_lock<std::mutex> lock(mutex);
-            if (fired)
+            if (fired || abandoned)
                 return;
-            cv.wait(lock, [this] { return fired; });
+            cv.wait(lock, [this] { return fired || abandoned; });
+        }
+
+        // Wait for the signal, giving up once 'give_up' returns true. Whatever makes it true must
+        // call notify() for a waiter to notice. Returns true if the signal fired.
+        template <typename Pred>
+        bool wait_unless(Pred give_up)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return fired || abandoned || give_up(); });
+            return fired;
+        }
+
+        // Wake any waiters to re-check their reason to give up.
+        void notify()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.notify_all();
         }
 
         void fire()
@@ -25,10 +42,28 @@ namespace unreal_debugger::client::signals
             fired = false;
         }
 
+        // Release every waiter, now and until the signal is cleared. Used when the connection to
+        // Unreal has gone and nothing is ever going to fire the signal again.
+        void abandon()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            abandoned = true;
+            cv.notify_all();
+        }
+
+        // Return to the initial state.
+        void clear()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            fired = false;
+            abandoned = false;
+        }
+
     private:
         std::mutex mutex;
         std::condition_variable cv;
         bool fired = false;
+        bool abandoned = false;
     };
 
     extern signal line_received;
@@ -36,5 +71,13 @@ namespace unreal_debugger::client::signals
     extern signal breakpoint_hit;
     extern signal user_watches_received;
     extern signal breakpoint_added;
+
+    // Never fired: notified whenever the IO thread moves a stop on to its next phase, for handlers
+    // waiting on the phase with wait_unless.
+    extern signal stop_progress;
+
+    // Abandon or clear all of the above.
+    void abandon_all();
+    void clear_all();
 }
 
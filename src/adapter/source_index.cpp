@@ -0,0 +1,109 @@
+
+#include "client.h"
+#include "source_index.h"
+
+namespace unreal_debugger::client
+{
+
+source_index sources;
+
+// Normalize a source file path to the true path name on disk. The path that we have built by gluing a user-provided
+// source root to the package and class name that Unreal provided may not exactly match the true file name of the file
+// on disk due to casing differences. E.g. the source-root may not have the correct casing, and while fs::exists() ignores
+// the case differences VS Code currently doesn't do a great job at detecting two different casings of the same file name
+// as being the same. If the cases don't match and you have opened the file in VS Code (which uses the true file path as it
+// appears on disk) the debugger may open another copy of this same file when a breakpoint within it is hit but the source
+// path returned from the debugger doesn't match exactly.
+//
+// To help reduce this annoyance the file name is canonicalized to the true path recorded on disk before returning. This
+// is not simple to do on Windows, we need to actually open the file to query it, and it needs to use gross Win32 APIs.
+static std::string normalize_path(const std::string& path)
+{
+    HANDLE hnd;
+    char buf[MAX_PATH];
+
+    // Open the file to get a handle
+    hnd = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hnd == INVALID_HANDLE_VALUE)
+    {
+        log("normalize_path: Could not open file (error %d\n)", GetLastError());
+        return path;
+    }
+
+    // Get the 'final path name' from the handle. Try with a reasonable buffer first, and if that fails allocate
+    // one large enough to hold the result.
+    unsigned long sz = GetFinalPathNameByHandle(hnd, buf, MAX_PATH, 0);
+    std::string str;
+    if (sz < MAX_PATH)
+    {
+        str = buf;
+    }
+    else
+    {
+        auto large_buf = std::make_unique<char[]>(sz + 1);
+        GetFinalPathNameByHandle(hnd, large_buf.get(), sz + 1, 0);
+        str = large_buf.get();
+    }
+
+    // We're now done with the handle
+    CloseHandle(hnd);
+
+    // The returned string may be prefixed with the \\?\ long path prefix. Strip it, cause VS Code doesn't want to
+    // see it.
+    if (str.find(R"(\\?\)") == 0)
+        str = str.substr(4);
+    return str;
+}
+
+std::string source_index::roots_key(const std::vector<fs::path>& roots)
+{
+    std::string key;
+    for (const fs::path& root : roots)
+    {
+        key += root.string();
+        key += '|';
+    }
+    return key;
+}
+
+// Given a class name, return a source name by attempting to apply each of the source roots in order.
+std::string source_index::class_to_source(const std::vector<fs::path>& roots, const std::string& class_name)
+{
+    std::string key = roots_key(roots);
+
+    // Try to find a cached version of the file first.
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        if (auto roots_it = cache_.find(key); roots_it != cache_.end())
+        {
+            if (auto it = roots_it->second.find(class_name); it != roots_it->second.end())
+            {
+                return it->second;
+            }
+        }
+    }
+
+    // No dice. Split the name into package and file name and search the source roots until we find a match
+    // (or don't). This is done without holding the lock: two sessions racing to look up the same class will
+    // both find the same answer.
+    auto idx = class_name.find('.');
+    std::string package = class_name.substr(0, idx);
+    std::string file = class_name.substr(idx + 1);
+
+    for (fs::path path : roots)
+    {
+        path = path / package / "Classes" / (file + ".uc");
+        if (fs::exists(path))
+        {
+            std::string normalized = normalize_path(path.string());
+
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            cache_[key].insert({ class_name, normalized });
+            return normalized;
+        }
+    }
+    log("Error: Cannot find source path for %s\n", class_name.c_str());
+    return class_name;
+}
+
+}
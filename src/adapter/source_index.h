@@ -0,0 +1,44 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+namespace unreal_debugger::client
+{
+
+namespace fs = std::filesystem;
+
+// Maps Unreal class names to source files on disk.
+//
+// Unreal only tells us a "Package.Class" name, so finding the file means probing each of the
+// session's source roots in turn and then normalizing the path we find, both of which hit the
+// file system. The results are cached for the life of the process rather than the life of a
+// session, so when the adapter runs as a server a second session on the same project is warm
+// from its very first stack trace.
+//
+// The same class can map to different files for sessions with different source roots, so the
+// cache is keyed by the list of roots as well as the class. The index is shared by all sessions
+// and is safe to use from any thread.
+class source_index
+{
+public:
+    // Find the source file for a class by searching the given roots in order. Returns the class
+    // name itself if no file can be found.
+    std::string class_to_source(const std::vector<fs::path>& roots, const std::string& class_name);
+
+private:
+    // Build the cache key for a list of source roots.
+    static std::string roots_key(const std::vector<fs::path>& roots);
+
+    std::shared_mutex mutex_;
+
+    // Cached file names per set of source roots, then per class name.
+    std::map<std::string, std::map<std::string, std::string>> cache_;
+};
+
+extern source_index sources;
+
+}
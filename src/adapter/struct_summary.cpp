@@ -0,0 +1,86 @@
+#include "struct_summary.h"
+
+#include <boost/algorithm/string.hpp>
+
+namespace unreal_debugger::client
+{
+
+struct_summaries summaries;
+
+struct_summaries::struct_summaries()
+{
+    reset();
+}
+
+void struct_summaries::reset()
+{
+    formats_ = {
+        { "VECTOR", "(X={X},Y={Y},Z={Z})" },
+        { "VECTOR2D", "(X={X},Y={Y})" },
+        { "VECTOR4", "(X={X},Y={Y},Z={Z},W={W})" },
+        { "ROTATOR", "(Pitch={Pitch},Yaw={Yaw},Roll={Roll})" },
+        { "QUAT", "(X={X},Y={Y},Z={Z},W={W})" },
+        { "COLOR", "(R={R},G={G},B={B},A={A})" },
+        { "LINEARCOLOR", "(R={R},G={G},B={B},A={A})" },
+        { "INTPOINT", "(X={X},Y={Y})" },
+    };
+}
+
+void struct_summaries::set(const std::string& type, const std::string& format)
+{
+    formats_[boost::algorithm::to_upper_copy(type)] = format;
+}
+
+std::optional<std::string> struct_summaries::summarize(const watch_list& list, const watch_view& watch) const
+{
+    if (watch.children.empty())
+    {
+        return {};
+    }
+
+    auto it = formats_.find(boost::algorithm::to_upper_copy(std::string{ watch.type }));
+    if (it == formats_.end() || it->second.empty())
+    {
+        return {};
+    }
+
+    const std::string& format = it->second;
+    std::string summary;
+    std::size_t pos = 0;
+    while (pos < format.size())
+    {
+        std::size_t open = format.find('{', pos);
+        std::size_t close = open == std::string::npos ? std::string::npos : format.find('}', open);
+        if (close == std::string::npos)
+        {
+            summary.append(format, pos, std::string::npos);
+            break;
+        }
+
+        summary.append(format, pos, open - pos);
+
+        // Find the member. Structs have few members so a search of the children is cheap.
+        std::string member = format.substr(open + 1, close - open - 1);
+        bool found = false;
+        for (int child : watch.children)
+        {
+            watch_view child_watch = list[child];
+            if (boost::algorithm::iequals(child_watch.name, member))
+            {
+                summary += child_watch.value;
+                found = true;
+                break;
+            }
+        }
+
+        if (!found)
+        {
+            return {};
+        }
+
+        pos = close + 1;
+    }
+    return summary;
+}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <map>
+#include <optional>
+#include <string>
+
+#include "watches.h"
+
+namespace unreal_debugger::client
+{
+
+// One-line summaries of struct values, such as "(X=1.000000,Y=2.000000,Z=0.000000)" for a Vector.
+//
+// Unreal sends no value of its own for a struct, only its members, so reading even a Vector means
+// expanding it and asking for its children. The members are already in the watch list, so for the
+// common engine structs the adapter shows them in the struct's own value instead.
+//
+// A summary is made from a format for the struct's type in which each "{Member}" is replaced by the
+// value of that member. If the struct doesn't have every member the format names it gets no summary.
+// Types and member names are matched without regard to case, like UnrealScript names.
+//
+// The table has defaults for the common engine structs. Launch and attach requests can add formats for
+// other types, or change or turn off (with an empty format) the defaults. It is configured before a
+// session starts debugging and is only read after that.
+class struct_summaries
+{
+public:
+    struct_summaries();
+
+    // Return to the default formats.
+    void reset();
+
+    // Set the format for a type. An empty format turns off summaries for the type.
+    void set(const std::string& type, const std::string& format);
+
+    // Summarize a watch from its children in the list, if its type has a format.
+    std::optional<std::string> summarize(const watch_list& list, const watch_view& watch) const;
+
+private:
+    // Formats keyed by upcased type name.
+    std::map<std::string, std::string> formats_;
+};
+
+extern struct_summaries summaries;
+
+}
@@ -0,0 +1,34 @@
+#include "symbols.h"
+
+namespace unreal_debugger::client
+{
+
+static const std::string empty_name;
+
+symbol::symbol() : str_{ &empty_name }
+{}
+
+symbol symbol_table::intern(std::string_view name)
+{
+    if (name.empty())
+    {
+        return symbol{};
+    }
+
+    if (auto it = index_.find(name); it != index_.end())
+    {
+        return symbol{ it->second };
+    }
+
+    const std::string& str = names_.emplace_back(name);
+    index_.emplace(str, &str);
+    return symbol{ &str };
+}
+
+void symbol_table::clear()
+{
+    index_.clear();
+    names_.clear();
+}
+
+}
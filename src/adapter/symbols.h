@@ -0,0 +1,54 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace unreal_debugger::client
+{
+
+// An interned class or function name. A symbol is just a pointer to the one copy of its text held
+// by the symbol table, so it is as cheap to copy and compare as an int.
+class symbol
+{
+public:
+    symbol();
+
+    const std::string& str() const { return *str_; }
+    bool empty() const { return str_->empty(); }
+
+    bool operator==(symbol other) const { return str_ == other.str_; }
+    bool operator!=(symbol other) const { return str_ != other.str_; }
+
+private:
+    friend class symbol_table;
+
+    explicit symbol(const std::string* str) : str_{ str }
+    {}
+
+    const std::string* str_;
+};
+
+// The table of interned names for a session.
+//
+// A deep call stack repeats the same few class and function names many times over, and every stop
+// repeats most of the names of the stop before it. Interning them means each name is stored once
+// and a frame only holds a pointer to it.
+//
+// Names are only interned on the IO thread. The text of a symbol never moves once interned, so a
+// handler thread may read a symbol it got from a snapshot without any locking. The table must only
+// be cleared when no snapshot that could refer to it is still in use.
+class symbol_table
+{
+public:
+    symbol intern(std::string_view name);
+    void clear();
+
+private:
+    // Deque elements never move as the deque grows, so the index can point into it.
+    std::deque<std::string> names_;
+    std::unordered_map<std::string_view, const std::string*> index_;
+};
+
+}
@@ -0,0 +1,139 @@
+#include "watch_export.h"
+#include "debugger.h"
+
+#include <fstream>
+
+namespace unreal_debugger::client
+{
+
+static const char* kind_names[] = { "local", "global", "user" };
+
+// Append a string to a JSON record as a quoted string. Unreal's text is ISO-8859-1, so each byte is one
+// character.
+static void append_json_string(std::string& out, std::string_view str)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    out += '"';
+    for (char c : str)
+    {
+        unsigned char p = static_cast<unsigned char>(c);
+        switch (p)
+        {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (p < 0x20)
+            {
+                out += "\\u00";
+                out += hex[p >> 4];
+                out += hex[p & 0xf];
+            }
+            else if (p < 0x80)
+            {
+                out += static_cast<char>(p);
+            }
+            else
+            {
+                out += static_cast<char>(0xc0 | (p >> 6));
+                out += static_cast<char>(0x80 | (p & 0x3f));
+            }
+        }
+    }
+    out += '"';
+}
+
+static void append_u32(std::string& out, std::uint32_t value)
+{
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        out += static_cast<char>((value >> shift) & 0xff);
+    }
+}
+
+static void append_binary_string(std::string& out, std::string_view str)
+{
+    append_u32(out, static_cast<std::uint32_t>(str.size()));
+    out += str;
+}
+
+static void append_record(std::string& out, export_format format, watch_kind kind, int index, const watch_view& watch)
+{
+    if (format == export_format::json_lines)
+    {
+        out += "{\"kind\":\"";
+        out += kind_names[static_cast<int>(kind)];
+        out += "\",\"index\":";
+        out += std::to_string(index);
+        out += ",\"parent\":";
+        out += std::to_string(watch.parent);
+        out += ",\"name\":";
+        append_json_string(out, watch.name);
+        out += ",\"type\":";
+        append_json_string(out, watch.type);
+        out += ",\"value\":";
+        append_json_string(out, watch.value);
+        out += "}\n";
+    }
+    else
+    {
+        out += static_cast<char>(kind);
+        append_u32(out, static_cast<std::uint32_t>(index));
+        append_u32(out, static_cast<std::uint32_t>(watch.parent));
+        append_binary_string(out, watch.name);
+        append_binary_string(out, watch.type);
+        append_binary_string(out, watch.value);
+    }
+}
+
+std::optional<std::string> export_watches(const stack_frame& frame, const std::filesystem::path& path, export_format format, export_stats& stats)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        return "Could not open " + path.string() + " for writing";
+    }
+
+    std::string record;
+    if (format == export_format::binary)
+    {
+        record = "UWX1";
+    }
+
+    // Records are gathered into one buffer and written once it has grown to a reasonable size.
+    constexpr std::size_t flush_size = 64 * 1024;
+
+    for (watch_kind kind : { watch_kind::local, watch_kind::global, watch_kind::user })
+    {
+        const watch_list& list = frame.get_watches(kind);
+
+        // Index 0 is the root, which isn't a real watch.
+        for (int index = 1; index < static_cast<int>(list.size()); ++index)
+        {
+            append_record(record, format, kind, index, list[index]);
+            ++stats.watches;
+
+            if (record.size() >= flush_size)
+            {
+                file.write(record.data(), record.size());
+                stats.bytes += record.size();
+                record.clear();
+            }
+        }
+    }
+
+    file.write(record.data(), record.size());
+    stats.bytes += record.size();
+    file.close();
+
+    if (!file)
+    {
+        return "Error writing " + path.string();
+    }
+    return {};
+}
+
+}
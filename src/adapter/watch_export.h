@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+namespace unreal_debugger::client
+{
+
+struct stack_frame;
+
+// Writing the watches of a frame to a file, for comparing the state of the game between stops offline.
+//
+// The locals, globals and user watches of the frame are written in that order, each list in index
+// order so every watch comes after its parent. The writer streams straight from the frame's watch lists
+// through one reused record buffer, so it needs no more memory for a list of a million watches than
+// for a list of ten.
+//
+// JSON Lines: one object per watch with "kind" ("local", "global" or "user"), "index", "parent" (-1
+// for a top-level watch), "name", "type" and "value", all text converted to UTF-8.
+//
+// Binary: the 4 bytes "UWX1", then for each watch a byte for the kind (0 local, 1 global, 2 user), the
+// index and parent as 32-bit integers, then the name, type and value each as a 32-bit length followed
+// by that many bytes of text in the game's character set. Integers are little-endian.
+enum class export_format
+{
+    json_lines,
+    binary
+};
+
+struct export_stats
+{
+    std::uint64_t bytes = 0;
+    std::uint64_t watches = 0;
+};
+
+// Write the watches of a frame to a file. Returns an error message if the file can't be written.
+std::optional<std::string> export_watches(const stack_frame& frame, const std::filesystem::path& path, export_format format, export_stats& stats);
+
+}
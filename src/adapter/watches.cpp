@@ -0,0 +1,446 @@
+#include "watches.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+
+namespace unreal_debugger::client
+{
+
+// A new list is empty, and all empty lists share the same empty schema.
+static const std::shared_ptr<const watch_schema> empty_schema = std::make_shared<watch_schema>();
+
+// The kind of column to try first for an array of the given element type. Anything that isn't a number
+// or a bool is kept in a dictionary.
+static packed_kind kind_for_type(const std::string& type)
+{
+    if (type == "Int") return packed_kind::int32;
+    if (type == "Float") return packed_kind::float32;
+    if (type == "Bool") return packed_kind::boolean;
+    if (type == "Byte") return packed_kind::byte;
+    return packed_kind::dictionary;
+}
+
+static std::string_view format_float(float value, char* buf, std::size_t size)
+{
+    int length = snprintf(buf, size, "%f", value);
+    return std::string_view{ buf, static_cast<std::size_t>(std::clamp(length, 0, static_cast<int>(size) - 1)) };
+}
+
+static std::string format_float(float value)
+{
+    char buf[64];
+    return std::string{ format_float(value, buf, sizeof(buf)) };
+}
+
+static std::string_view format_int(int value, char* buf, std::size_t size)
+{
+    auto [end, ec] = std::to_chars(buf, buf + size, value);
+    return std::string_view{ buf, static_cast<std::size_t>(end - buf) };
+}
+
+static bool parse_int(const std::string& str, std::int32_t& value)
+{
+    auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    return ec == std::errc{} && end == str.data() + str.size();
+}
+
+// Parse one element of a numeric array. An element is only stored as a number if formatting that number
+// gives back exactly the string Unreal sent: anything else ("1e5", "007", "-0", ...) makes the array a
+// dictionary instead.
+static bool pack_value(packed_kind kind, const std::string& str, packed_column& column)
+{
+    switch (kind)
+    {
+    case packed_kind::int32:
+    {
+        std::int32_t value;
+        if (!parse_int(str, value) || std::to_string(value) != str)
+        {
+            return false;
+        }
+        column.ints.push_back(value);
+        return true;
+    }
+    case packed_kind::byte:
+    {
+        std::int32_t value;
+        if (!parse_int(str, value) || value < 0 || value > 255 || std::to_string(value) != str)
+        {
+            return false;
+        }
+        column.bytes.push_back(static_cast<std::uint8_t>(value));
+        return true;
+    }
+    case packed_kind::boolean:
+        if (str != "True" && str != "False")
+        {
+            return false;
+        }
+        column.bytes.push_back(str == "True");
+        return true;
+    case packed_kind::float32:
+    {
+        char* end;
+        float value = strtof(str.c_str(), &end);
+        if (str.empty() || end != str.c_str() + str.size() || format_float(value) != str)
+        {
+            return false;
+        }
+        column.floats.push_back(value);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+// Fill a column from 'count' values starting at 'first'.
+static bool pack_column(packed_kind kind, const std::vector<std::string>& values, int first, int count, packed_column& column)
+{
+    if (kind == packed_kind::dictionary)
+    {
+        std::unordered_map<std::string, std::uint32_t> ids;
+        column.ids.reserve(count);
+        for (int i = first; i < first + count; ++i)
+        {
+            auto [it, inserted] = ids.emplace(values[i], static_cast<std::uint32_t>(column.strings.size()));
+            if (inserted)
+            {
+                column.strings.push_back(values[i]);
+            }
+            column.ids.push_back(it->second);
+        }
+        return true;
+    }
+
+    for (int i = first; i < first + count; ++i)
+    {
+        if (!pack_value(kind, values[i], column))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+watch_view::watch_view(const packed_run& run, const packed_column& column, int element) :
+    type{ run.type }, parent{ run.parent }, children{ 0, 0 }
+{
+    name_buffer_[0] = '[';
+    name = format_int(element, name_buffer_ + 1, sizeof(name_buffer_) - 2);
+    name_buffer_[name.size() + 1] = ']';
+    name = std::string_view{ name_buffer_, name.size() + 2 };
+
+    switch (run.kind)
+    {
+    case packed_kind::int32: value = format_int(column.ints[element], value_buffer_, sizeof(value_buffer_)); break;
+    case packed_kind::float32: value = format_float(column.floats[element], value_buffer_, sizeof(value_buffer_)); break;
+    case packed_kind::boolean: value = column.bytes[element] ? "True" : "False"; break;
+    case packed_kind::byte: value = format_int(column.bytes[element], value_buffer_, sizeof(value_buffer_)); break;
+    default: value = column.strings[column.ids[element]]; break;
+    }
+}
+
+watch_list::watch_list() : schema_{ empty_schema }
+{}
+
+watch_list::watch_list(const watch_list& other) :
+    schema_{ other.schema_ },
+    values_{ other.values_ },
+    columns_{ other.columns_ }
+{}
+
+watch_list& watch_list::operator=(const watch_list& other)
+{
+    schema_ = other.schema_;
+    building_.reset();
+    values_ = other.values_;
+    columns_ = other.columns_;
+    return *this;
+}
+
+std::size_t watch_list::packed_size() const
+{
+    const std::vector<packed_run>& runs = schema_->runs;
+    return runs.empty() ? 0 : runs.back().offset + runs.back().count;
+}
+
+int watch_list::position(int index, const packed_run** run) const
+{
+    const std::vector<packed_run>& runs = schema_->runs;
+    auto it = std::upper_bound(runs.begin(), runs.end(), index, [](int i, const packed_run& r) { return i < r.first; });
+    if (it == runs.begin())
+    {
+        return index;
+    }
+
+    const packed_run& prev = *(it - 1);
+    if (index < prev.first + prev.count)
+    {
+        if (run)
+        {
+            *run = &prev;
+        }
+        return -1;
+    }
+    return index - prev.offset - prev.count;
+}
+
+watch_view watch_list::operator[](int index) const
+{
+    const packed_run* run = nullptr;
+    int pos = position(index, &run);
+    if (pos < 0)
+    {
+        const packed_column& column = columns_[run - schema_->runs.data()];
+        return watch_view(*run, column, index - run->first);
+    }
+
+    const watch_node& node = schema_->nodes[pos];
+    watch_children children = node.packed_count > 0 ? watch_children{ node.packed_first, node.packed_count } : watch_children{ node.children };
+    return watch_view(node.name, node.type, values_[pos], node.parent, children);
+}
+
+void watch_list::reserve(std::size_t size)
+{
+    values_.reserve(size);
+    if (building_)
+    {
+        building_->nodes.reserve(size);
+    }
+}
+
+void watch_list::add(std::string name, std::string type, std::string value, int parent)
+{
+    if (!building_)
+    {
+        // The schema is shared: this list needs its own before it can change shape.
+        building_ = std::make_shared<watch_schema>(*schema_);
+        building_->nodes.reserve(values_.capacity());
+        schema_ = building_;
+    }
+
+    int index = static_cast<int>(size());
+    building_->nodes.emplace_back(std::move(name), std::move(type), parent);
+    values_.push_back(std::move(value));
+
+    // Add this element to its parent's children list for easy access. Top-level items are children of the
+    // root node. A packed element is never a parent: only arrays of leaves are packed.
+    if (parent >= 1)
+    {
+        if (int pos = position(parent); pos >= 0)
+        {
+            building_->nodes[pos].children.push_back(index);
+        }
+    }
+    else if (parent == -1 && index > 0)
+    {
+        building_->nodes[0].children.push_back(index);
+    }
+}
+
+void watch_list::pack_arrays()
+{
+    if (!building_)
+    {
+        return;
+    }
+
+    std::vector<watch_node>& nodes = building_->nodes;
+    std::vector<packed_run>& runs = building_->runs;
+
+    struct found_run
+    {
+        packed_run run;
+        packed_column column;
+        int pos;
+    };
+    std::vector<found_run> found;
+
+    // Walk the nodes keeping track of the index of each, which is its position plus the number of
+    // packed elements before it.
+    std::size_t next_run = 0;
+    int skipped = 0;
+    for (int pos = 0; pos < static_cast<int>(nodes.size()); ++pos)
+    {
+        while (next_run < runs.size() && runs[next_run].first <= pos + skipped)
+        {
+            skipped += runs[next_run].count;
+            ++next_run;
+        }
+
+        watch_node& node = nodes[pos];
+        int count = static_cast<int>(node.children.size());
+        if (count < min_packed_run)
+        {
+            continue;
+        }
+
+        // The elements must be consecutive leaves of the same type, named by their index.
+        int first = node.children.front();
+        int first_pos = position(first);
+        bool homogeneous = first_pos >= 0 && first_pos + count <= static_cast<int>(nodes.size());
+        for (int i = 0; homogeneous && i < count; ++i)
+        {
+            const watch_node& element = nodes[first_pos + i];
+            homogeneous = node.children[i] == first + i
+                && element.children.empty()
+                && element.packed_count == 0
+                && element.type == nodes[first_pos].type
+                && element.name == "[" + std::to_string(i) + "]";
+        }
+
+        if (!homogeneous)
+        {
+            continue;
+        }
+
+        const std::string& type = nodes[first_pos].type;
+        packed_kind kind = kind_for_type(type);
+        packed_column column;
+        if (!pack_column(kind, values_, first_pos, count, column))
+        {
+            kind = packed_kind::dictionary;
+            column = packed_column{};
+            pack_column(kind, values_, first_pos, count, column);
+        }
+
+        found.push_back(found_run{ packed_run{ first, count, pos + skipped, kind, type }, std::move(column), first_pos });
+        node.children = std::vector<int>{};
+        node.packed_first = first;
+        node.packed_count = count;
+    }
+
+    if (found.empty())
+    {
+        return;
+    }
+
+    // Drop the nodes and values of the packed elements.
+    std::sort(found.begin(), found.end(), [](const found_run& a, const found_run& b) { return a.pos < b.pos; });
+
+    std::vector<watch_node> kept_nodes;
+    std::vector<std::string> kept_values;
+    kept_nodes.reserve(nodes.size());
+    kept_values.reserve(values_.size());
+    auto next = found.begin();
+    for (int pos = 0; pos < static_cast<int>(nodes.size()); ++pos)
+    {
+        if (next != found.end() && pos == next->pos)
+        {
+            pos += next->run.count - 1;
+            ++next;
+            continue;
+        }
+        kept_nodes.push_back(std::move(nodes[pos]));
+        kept_values.push_back(std::move(values_[pos]));
+    }
+    nodes = std::move(kept_nodes);
+    values_ = std::move(kept_values);
+
+    // Merge the new runs with any already packed, keeping them sorted by index.
+    std::vector<std::pair<packed_run, packed_column>> all;
+    all.reserve(runs.size() + found.size());
+    for (std::size_t i = 0; i < runs.size(); ++i)
+    {
+        all.emplace_back(std::move(runs[i]), std::move(columns_[i]));
+    }
+    for (found_run& f : found)
+    {
+        all.emplace_back(std::move(f.run), std::move(f.column));
+    }
+    std::sort(all.begin(), all.end(), [](const auto& a, const auto& b) { return a.first.first < b.first.first; });
+
+    runs.clear();
+    columns_.clear();
+    int offset = 0;
+    for (auto& [run, column] : all)
+    {
+        run.offset = offset;
+        offset += run.count;
+        runs.push_back(std::move(run));
+        columns_.push_back(std::move(column));
+    }
+}
+
+void watch_list::share_schema(std::shared_ptr<const watch_schema> schema)
+{
+    schema_ = std::move(schema);
+    building_.reset();
+}
+
+std::size_t watch_schema_table::hash(const watch_schema& schema)
+{
+    std::hash<std::string> hash_string;
+    std::size_t h = schema.nodes.size();
+    for (const watch_node& node : schema.nodes)
+    {
+        h = h * 31 + hash_string(node.name);
+        h = h * 31 + hash_string(node.type);
+        h = h * 31 + static_cast<std::size_t>(node.parent);
+    }
+    for (const packed_run& run : schema.runs)
+    {
+        h = h * 31 + static_cast<std::size_t>(run.first);
+        h = h * 31 + static_cast<std::size_t>(run.count);
+        h = h * 31 + static_cast<std::size_t>(run.kind);
+    }
+    return h;
+}
+
+void watch_schema_table::intern(watch_list& list)
+{
+    if (!list.building())
+    {
+        return;
+    }
+
+    const std::shared_ptr<const watch_schema>& schema = list.schema();
+    std::size_t h = hash(*schema);
+
+    auto [first, last] = schemas_.equal_range(h);
+    for (auto it = first; it != last;)
+    {
+        std::shared_ptr<const watch_schema> existing = it->second.lock();
+        if (!existing)
+        {
+            it = schemas_.erase(it);
+            continue;
+        }
+
+        if (*existing == *schema)
+        {
+            list.share_schema(std::move(existing));
+            return;
+        }
+        ++it;
+    }
+
+    schemas_.emplace(h, schema);
+    list.share_schema(schema);
+
+    if (schemas_.size() >= prune_at_)
+    {
+        prune();
+    }
+}
+
+// Remove the entries for schemas no list uses any more.
+void watch_schema_table::prune()
+{
+    for (auto it = schemas_.begin(); it != schemas_.end();)
+    {
+        it = it->second.expired() ? schemas_.erase(it) : std::next(it);
+    }
+    prune_at_ = std::max<std::size_t>(64, schemas_.size() * 2);
+}
+
+void watch_schema_table::clear()
+{
+    schemas_.clear();
+    prune_at_ = 64;
+}
+
+}
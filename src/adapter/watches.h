@@ -0,0 +1,243 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace unreal_debugger::client
+{
+
+// One watch in the tree of a watch list, without its value.
+struct watch_node
+{
+    watch_node(std::string n, std::string t, int p) :
+        name(std::move(n)), type(std::move(t)), parent(p)
+    {}
+
+    // Nodes are the same if they have the same name and type in the same place in the tree. The
+    // children follow from the parents of the nodes after them.
+    bool operator==(const watch_node& other) const
+    {
+        return parent == other.parent && name == other.name && type == other.type && packed_first == other.packed_first && packed_count == other.packed_count;
+    }
+
+    std::string name;
+    std::string type;
+    int parent;
+    std::vector<int> children;
+
+    // The elements of a packed array, which aren't in 'children'.
+    int packed_first = -1;
+    int packed_count = 0;
+};
+
+// How the values of a packed array are stored.
+enum class packed_kind
+{
+    int32,
+    float32,
+    boolean,
+    byte,
+    dictionary
+};
+
+// The elements of an array that have been packed into a column: a run of consecutive watches named
+// "[0]", "[1]", ... that have the same type and no children of their own.
+struct packed_run
+{
+    bool operator==(const packed_run& other) const
+    {
+        return first == other.first && count == other.count && parent == other.parent && kind == other.kind && type == other.type;
+    }
+
+    int first;
+    int count;
+    int parent;
+    packed_kind kind;
+    std::string type;
+
+    // The number of packed elements in the runs before this one.
+    int offset = 0;
+};
+
+// The shape of a watch list: the names, types and tree structure of its watches. Every frame running
+// the same function has the same locals, so in a recursive call stack many frames have lists with the
+// same schema and only the values differ. A schema is immutable once a list has finished building it,
+// and is then shared by every list with that shape.
+//
+// The elements of packed arrays have no nodes. Nodes are stored in the order of their indices with the
+// packed elements left out, and the runs are sorted by index.
+struct watch_schema
+{
+    bool operator==(const watch_schema& other) const { return nodes == other.nodes && runs == other.runs; }
+
+    std::vector<watch_node> nodes;
+    std::vector<packed_run> runs;
+};
+
+// The indices of the children of a watch: either a list, or the run of a packed array.
+class watch_children
+{
+public:
+    class iterator
+    {
+    public:
+        iterator(const int* list, int pos) : list_{ list }, pos_{ pos }
+        {}
+
+        int operator*() const { return list_ ? list_[pos_] : pos_; }
+        iterator& operator++() { ++pos_; return *this; }
+        bool operator==(const iterator& other) const { return pos_ == other.pos_; }
+        bool operator!=(const iterator& other) const { return pos_ != other.pos_; }
+
+    private:
+        const int* list_;
+        int pos_;
+    };
+
+    explicit watch_children(const std::vector<int>& list) :
+        list_{ list.data() }, first_{ 0 }, count_{ static_cast<int>(list.size()) }
+    {}
+
+    watch_children(int first, int count) :
+        list_{ nullptr }, first_{ first }, count_{ count }
+    {}
+
+    std::size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    iterator begin() const { return iterator{ list_, first_ }; }
+    iterator end() const { return iterator{ list_, first_ + count_ }; }
+
+private:
+    const int* list_;
+    int first_;
+    int count_;
+};
+
+struct packed_column;
+
+// A watch as read from a watch list. The strings are those of the list, which must outlive the view,
+// except for the name and value of a packed array element: those are formatted into the view when it is
+// read, so a view can't be copied.
+class watch_view
+{
+public:
+    watch_view(const watch_view&) = delete;
+    watch_view& operator=(const watch_view&) = delete;
+
+    std::string_view name;
+    std::string_view type;
+    std::string_view value;
+    int parent;
+    watch_children children;
+
+private:
+    friend class watch_list;
+
+    watch_view(std::string_view n, std::string_view t, std::string_view v, int p, watch_children c) :
+        name{ n }, type{ t }, value{ v }, parent{ p }, children{ c }
+    {}
+
+    watch_view(const packed_run& run, const packed_column& column, int element);
+
+    // Enough for "[2147483647]" and for any float printed with "%f".
+    char name_buffer_[16];
+    char value_buffer_[64];
+};
+
+// The values of a packed array, in the form its kind needs.
+struct packed_column
+{
+    std::vector<std::int32_t> ints;
+    std::vector<float> floats;
+    std::vector<std::uint8_t> bytes;
+
+    // A dictionary column holds each distinct value once and an id per element.
+    std::vector<std::uint32_t> ids;
+    std::vector<std::string> strings;
+};
+
+// A watch list: a schema, and the values of its watches in the same order.
+//
+// Watches are added to a list on the IO thread, which builds the list a schema of its own. Once the list
+// is complete its arrays are packed and its schema is swapped for the matching one in the schema table,
+// if there is one. A copy of a list shares the schema it was copied from, and takes a private copy of
+// it only if a watch is added.
+//
+// Indices are those Unreal assigned: packing an array doesn't change the index of any watch.
+class watch_list
+{
+public:
+    // The fewest elements an array must have to be packed. Smaller arrays aren't worth it.
+    static constexpr int min_packed_run = 32;
+
+    watch_list();
+    watch_list(const watch_list& other);
+    watch_list(watch_list&& other) = default;
+    watch_list& operator=(const watch_list& other);
+    watch_list& operator=(watch_list&& other) = default;
+
+    std::size_t size() const { return values_.size() + packed_size(); }
+    bool empty() const { return size() == 0; }
+    watch_view operator[](int index) const;
+
+    void reserve(std::size_t size);
+    void add(std::string name, std::string type, std::string value, int parent);
+
+    // Pack the elements of each large array whose elements are all leaves of the same type into a
+    // column. Only a list that is building its own schema can be packed.
+    void pack_arrays();
+
+    // True if the list has built a schema that hasn't been shared yet.
+    bool building() const { return building_ != nullptr; }
+
+    const std::shared_ptr<const watch_schema>& schema() const { return schema_; }
+
+    // Replace the list's schema with an identical one.
+    void share_schema(std::shared_ptr<const watch_schema> schema);
+
+private:
+    std::size_t packed_size() const;
+
+    // The position of the watch with the given index in the nodes and values, or -1 for a packed element.
+    // If 'run' is given it is set to the run a packed element is in.
+    int position(int index, const packed_run** run = nullptr) const;
+
+    std::shared_ptr<const watch_schema> schema_;
+
+    // The schema this list is building, which is also 'schema_'. Copies of the list never share it.
+    std::shared_ptr<watch_schema> building_;
+
+    std::vector<std::string> values_;
+
+    // The values of each packed run, in the same order as the schema's runs.
+    std::vector<packed_column> columns_;
+};
+
+// The table of shared watch list schemas for a session. Only used on the IO thread.
+//
+// The table doesn't keep schemas alive: a schema lasts as long as some watch list uses it, and the table's
+// entries for schemas that are gone are pruned as it goes.
+class watch_schema_table
+{
+public:
+    // Share the schema of a list that has finished building, either with an identical schema already
+    // in the table or by adding it.
+    void intern(watch_list& list);
+    void clear();
+
+private:
+    static std::size_t hash(const watch_schema& schema);
+
+    void prune();
+
+    std::unordered_multimap<std::size_t, std::weak_ptr<const watch_schema>> schemas_;
+
+    // The table is swept of expired entries whenever it grows to twice its size after the last sweep.
+    std::size_t prune_at_ = 64;
+};
+
+}
@@ -25,7 +25,8 @@ namespace unreal_debugger::serialization::commands
         step_into,
         step_over,
         step_out_of,
-        toggle_watch_info
+        toggle_watch_info,
+        resume
     };
 
     struct command
@@ -60,9 +61,9 @@ namespace unreal_debugger::serialization::commands
             line_number_{ ln }
         {}
 
-        add_breakpoint(const message& msg) : command{ command_kind::add_breakpoint }
+        add_breakpoint(const message_view& msg) : command{ command_kind::add_breakpoint }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
 
             command_kind k = deserialize_command_kind(raw_buf);
             assert(k == command_kind::add_breakpoint);
@@ -70,7 +71,7 @@ namespace unreal_debugger::serialization::commands
             class_name_ = deserialize_string(raw_buf);
             line_number_ = deserialize_int(raw_buf);
 
-            assert(msg.len_ == (raw_buf - msg.buf_.get()));
+            assert(msg.len_ == (raw_buf - msg.buf_));
         }
 
         virtual message serialize() const
@@ -103,16 +104,16 @@ namespace unreal_debugger::serialization::commands
             line_number_{ln}
         {}
 
-        remove_breakpoint(const message& msg) : command{ command_kind::remove_breakpoint }
+        remove_breakpoint(const message_view& msg) : command{ command_kind::remove_breakpoint }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
 
             command_kind k = deserialize_command_kind(raw_buf);
             assert(k == command_kind::remove_breakpoint);
             class_name_ = deserialize_string(raw_buf);
             line_number_ = deserialize_int(raw_buf);
 
-            assert(msg.len_ == (raw_buf - msg.buf_.get()));
+            assert(msg.len_ == (raw_buf - msg.buf_));
         }
 
         virtual message serialize() const
@@ -144,15 +145,15 @@ namespace unreal_debugger::serialization::commands
             var_name_{ n }
         {}
 
-        add_watch(const message& msg) : command{ command_kind::add_watch }
+        add_watch(const message_view& msg) : command{ command_kind::add_watch }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
 
             command_kind k = deserialize_command_kind(raw_buf);
             assert(k == command_kind::add_watch);
             var_name_ = deserialize_string(raw_buf);
 
-            assert(msg.len_ == (raw_buf - msg.buf_.get()));
+            assert(msg.len_ == (raw_buf - msg.buf_));
         }
 
         virtual message serialize() const
@@ -179,14 +180,14 @@ namespace unreal_debugger::serialization::commands
         remove_watch() : command{ command_kind::remove_watch }
         {}
 
-        remove_watch(const message& msg) : command{ command_kind::remove_watch }
+        remove_watch(const message_view& msg) : command{ command_kind::remove_watch }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
 
             command_kind k = deserialize_command_kind(raw_buf);
             assert(k == command_kind::remove_watch);
             var_name_ = deserialize_string(raw_buf);
-            assert(msg.len_ == (raw_buf - msg.buf_.get()));
+            assert(msg.len_ == (raw_buf - msg.buf_));
         }
 
         virtual message serialize() const
@@ -213,13 +214,13 @@ namespace unreal_debugger::serialization::commands
         clear_watch() : command{ command_kind::clear_watch }
         {}
 
-        clear_watch(const message& msg) : command{ command_kind::clear_watch }
+        clear_watch(const message_view& msg) : command{ command_kind::clear_watch }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
 
             command_kind k = deserialize_command_kind(raw_buf);
             assert(k == command_kind::clear_watch);
-            assert(msg.len_ == (raw_buf - msg.buf_.get()));
+            assert(msg.len_ == (raw_buf - msg.buf_));
         }
 
         virtual message serialize() const
@@ -235,15 +236,15 @@ namespace unreal_debugger::serialization::commands
             stack_id_{ id }
         {}
 
-        change_stack(const message& msg) : command{ command_kind::change_stack }
+        change_stack(const message_view& msg) : command{ command_kind::change_stack }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
 
             command_kind k = deserialize_command_kind(raw_buf);
             assert(k == command_kind::change_stack);
             stack_id_ = deserialize_int(raw_buf);
 
-            assert(msg.len_ == (raw_buf - msg.buf_.get()));
+            assert(msg.len_ == (raw_buf - msg.buf_));
         }
 
         virtual message serialize() const
@@ -272,15 +273,15 @@ namespace unreal_debugger::serialization::commands
             var_name_{ v }
         {}
 
-        set_data_watch(const message& msg) : command{ command_kind::set_data_watch }
+        set_data_watch(const message_view& msg) : command{ command_kind::set_data_watch }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
 
             command_kind k = deserialize_command_kind(raw_buf);
             assert(k == command_kind::set_data_watch);
             var_name_ = deserialize_string(raw_buf);
 
-            assert(msg.len_ == (raw_buf - msg.buf_.get()));
+            assert(msg.len_ == (raw_buf - msg.buf_));
         }
 
         virtual message serialize() const
@@ -309,14 +310,14 @@ namespace unreal_debugger::serialization::commands
             break_value_{ b }
         {}
 
-        break_on_none(const message& msg) : command{ command_kind::break_on_none }
+        break_on_none(const message_view& msg) : command{ command_kind::break_on_none }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
 
             command_kind k = deserialize_command_kind(raw_buf);
             assert(k == command_kind::break_on_none);
             break_value_ = deserialize_bool(raw_buf);
-            assert(msg.len_ == (raw_buf - msg.buf_.get()));
+            assert(msg.len_ == (raw_buf - msg.buf_));
         }
 
         virtual message serialize() const
@@ -343,13 +344,13 @@ namespace unreal_debugger::serialization::commands
         break_cmd() : command{ command_kind::break_cmd }
         {}
 
-        break_cmd(const message& msg) : command{ command_kind::break_cmd }
+        break_cmd(const message_view& msg) : command{ command_kind::break_cmd }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
 
             command_kind k = deserialize_command_kind(raw_buf);
             assert(k == command_kind::break_cmd);
-            assert(msg.len_ == (raw_buf - msg.buf_.get()));
+            assert(msg.len_ == (raw_buf - msg.buf_));
         }
 
         virtual message serialize() const
@@ -363,13 +364,13 @@ namespace unreal_debugger::serialization::commands
         stop_debugging() : command{ command_kind::stop_debugging }
         {}
 
-        stop_debugging(const message& msg) : command{ command_kind::stop_debugging }
+        stop_debugging(const message_view& msg) : command{ command_kind::stop_debugging }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
 
             command_kind k = deserialize_command_kind(raw_buf);
             assert(k == command_kind::stop_debugging);
-            assert(msg.len_ == (raw_buf - msg.buf_.get()));
+            assert(msg.len_ == (raw_buf - msg.buf_));
         }
 
         virtual message serialize() const
@@ -383,13 +384,13 @@ namespace unreal_debugger::serialization::commands
         go() : command{ command_kind::go }
         {}
 
-        go(const message& msg) : command{ command_kind::go }
+        go(const message_view& msg) : command{ command_kind::go }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
 
             command_kind k = deserialize_command_kind(raw_buf);
             assert(k == command_kind::go);
-            assert(msg.len_ == (raw_buf - msg.buf_.get()));
+            assert(msg.len_ == (raw_buf - msg.buf_));
         }
 
         virtual message serialize() const
@@ -403,13 +404,13 @@ namespace unreal_debugger::serialization::commands
         step_into() : command{ command_kind::step_into }
         {}
 
-        step_into(const message& msg) : command{ command_kind::step_into }
+        step_into(const message_view& msg) : command{ command_kind::step_into }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
 
             command_kind k = deserialize_command_kind(raw_buf);
             assert(k == command_kind::step_into);
-            assert(msg.len_ == (raw_buf - msg.buf_.get()));
+            assert(msg.len_ == (raw_buf - msg.buf_));
         }
 
         virtual message serialize() const
@@ -423,13 +424,13 @@ namespace unreal_debugger::serialization::commands
         step_over() : command{ command_kind::step_over }
         {}
 
-        step_over(const message& msg) : command{ command_kind::step_over }
+        step_over(const message_view& msg) : command{ command_kind::step_over }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
 
             command_kind k = deserialize_command_kind(raw_buf);
             assert(k == command_kind::step_over);
-            assert(msg.len_ == (raw_buf - msg.buf_.get()));
+            assert(msg.len_ == (raw_buf - msg.buf_));
         }
 
         virtual message serialize() const
@@ -443,13 +444,13 @@ namespace unreal_debugger::serialization::commands
         step_out_of() : command{ command_kind::step_out_of }
         {}
 
-        step_out_of(const message& msg) : command{ command_kind::step_out_of }
+        step_out_of(const message_view& msg) : command{ command_kind::step_out_of }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
 
             command_kind k = deserialize_command_kind(raw_buf);
             assert(k == command_kind::step_out_of);
-            assert(msg.len_ == (raw_buf - msg.buf_.get()));
+            assert(msg.len_ == (raw_buf - msg.buf_));
         }
 
         virtual message serialize() const
@@ -465,14 +466,14 @@ namespace unreal_debugger::serialization::commands
             send_watch_info_{ b }
         {}
 
-        toggle_watch_info(const message& msg) : command{ command_kind::toggle_watch_info }
+        toggle_watch_info(const message_view& msg) : command{ command_kind::toggle_watch_info }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
 
             command_kind k = deserialize_command_kind(raw_buf);
             assert(k == command_kind::toggle_watch_info);
             send_watch_info_ = deserialize_bool(raw_buf);
-            assert(msg.len_ == (raw_buf - msg.buf_.get()));
+            assert(msg.len_ == (raw_buf - msg.buf_));
         }
 
         virtual message serialize() const
@@ -494,4 +495,71 @@ namespace unreal_debugger::serialization::commands
         bool send_watch_info_;
     };
 
+
+    // resume is not a real unreal command either. It resumes Unreal in one of the ways the 'go'
+    // and 'step' commands do, first doing whatever the flags ask for. The debugger would otherwise
+    // have to send each of these as a separate command at every resume.
+    enum class resume_kind : char
+    {
+        go,
+        step_into,
+        step_over,
+        step_out_of
+    };
+
+    namespace resume_flags
+    {
+        constexpr int none = 0;
+
+        // Turn watch info back on (as toggle_watch_info(true)).
+        constexpr int enable_watch_info = 1;
+
+        // Clear all user watches (as clear_watch).
+        constexpr int clear_watches = 2;
+
+        // Return Unreal to the top-most frame (as change_stack(0)), without sending watch info for it.
+        constexpr int reset_frame = 4;
+    }
+
+    struct resume : command
+    {
+        resume(resume_kind k, int flags) :
+            command{ command_kind::resume },
+            resume_kind_{ k },
+            flags_{ flags }
+        {}
+
+        resume(const message_view& msg) : command{ command_kind::resume }
+        {
+            char* raw_buf = msg.buf_;
+
+            command_kind k = deserialize_command_kind(raw_buf);
+            assert(k == command_kind::resume);
+            resume_kind_ = static_cast<resume_kind>(deserialize_int(raw_buf));
+            flags_ = deserialize_int(raw_buf);
+            assert(msg.len_ == (raw_buf - msg.buf_));
+        }
+
+        virtual message serialize() const
+        {
+            message msg;
+            msg.len_ =
+                sizeof(command_kind)    // kind field
+                + sizeof(int)           // resume kind
+                + sizeof(int)           // flags
+                ;
+
+            msg.buf_ = std::make_unique<char[]>(msg.len_);
+            char* raw_buf = msg.buf_.get();
+            serialize_command_kind(raw_buf, kind_);
+            serialize_int(raw_buf, static_cast<int>(resume_kind_));
+            serialize_int(raw_buf, flags_);
+            assert(msg.len_ == raw_buf - msg.buf_.get());
+            return msg;
+        }
+
+        resume_kind resume_kind_;
+        int flags_;
+    };
+
 }
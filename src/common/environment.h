@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdlib>
+#include <optional>
+#include <string>
+
+namespace unreal_debugger
+{
+    // Read an environment variable, returning an empty optional if it isn't set.
+    //
+    // Neither the interface nor the adapter have a config file: the interface is loaded by
+    // Unreal and the adapter is launched by the editor, so the environment is the one place
+    // both can be configured from outside.
+    inline std::optional<std::string> get_env(const char* name)
+    {
+#ifdef _MSC_VER
+        // MSVC deprecates getenv in favor of _dupenv_s.
+        char* buf = nullptr;
+        size_t len = 0;
+        if (_dupenv_s(&buf, &len, name) != 0 || buf == nullptr)
+        {
+            return {};
+        }
+
+        std::string value{ buf };
+        free(buf);
+        return value;
+#else
+        const char* value = std::getenv(name);
+        if (value == nullptr)
+        {
+            return {};
+        }
+        return std::string{ value };
+#endif
+    }
+
+    // Read an integer environment variable, returning 'def' if it isn't set or isn't a number.
+    inline int get_env_int(const char* name, int def)
+    {
+        auto value = get_env(name);
+        if (!value || value->empty())
+        {
+            return def;
+        }
+
+        char* end = nullptr;
+        long v = std::strtol(value->c_str(), &end, 0);
+        return *end == '\0' ? static_cast<int>(v) : def;
+    }
+}
@@ -27,7 +27,10 @@ namespace unreal_debugger::serialization::events
         call_stack_clear,
         call_stack_add,
         set_current_object_name,
-        terminated
+        terminated,
+        resumed,
+        call_stack_delta,
+        stop_begin
     };
 
     struct event
@@ -60,9 +63,9 @@ namespace unreal_debugger::serialization::events
         show_dll_form() : event{ event_kind::show_dll_form }
         {}
 
-        show_dll_form(const message& msg) : event{ event_kind::show_dll_form }
+        show_dll_form(const message_view& msg) : event{ event_kind::show_dll_form }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
             event_kind k = deserialize_event_kind(raw_buf);
             assert(k == event_kind::show_dll_form);
             verify_message(msg, raw_buf);
@@ -79,9 +82,9 @@ namespace unreal_debugger::serialization::events
         build_hierarchy() : event{ event_kind::build_hierarchy }
         {}
 
-        build_hierarchy(const message& msg) : event{ event_kind::build_hierarchy }
+        build_hierarchy(const message_view& msg) : event{ event_kind::build_hierarchy }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
             event_kind k = deserialize_event_kind(raw_buf);
             assert(k == event_kind::build_hierarchy);
             verify_message(msg, raw_buf);
@@ -98,9 +101,9 @@ namespace unreal_debugger::serialization::events
         clear_hierarchy() : event{ event_kind::clear_hierarchy }
         {}
 
-        clear_hierarchy(const message& msg) : event{ event_kind::clear_hierarchy }
+        clear_hierarchy(const message_view& msg) : event{ event_kind::clear_hierarchy }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
             event_kind k = deserialize_event_kind(raw_buf);
             assert(k == event_kind::clear_hierarchy);
             verify_message(msg, raw_buf);
@@ -119,9 +122,9 @@ namespace unreal_debugger::serialization::events
             class_name_{ n }
         {}
 
-        add_class_to_hierarchy(const message& msg) : event{ event_kind::add_class_to_hierarchy }
+        add_class_to_hierarchy(const message_view& msg) : event{ event_kind::add_class_to_hierarchy }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
             event_kind k = deserialize_event_kind(raw_buf);
             assert(k == event_kind::add_class_to_hierarchy);
             class_name_ = deserialize_string(raw_buf);
@@ -154,9 +157,9 @@ namespace unreal_debugger::serialization::events
             watch_type_{type}
         {}
 
-        clear_a_watch(const message& msg) : event{ event_kind::clear_a_watch }
+        clear_a_watch(const message_view& msg) : event{ event_kind::clear_a_watch }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
             event_kind k = deserialize_event_kind(raw_buf);
             assert(k == event_kind::clear_a_watch);
             watch_type_ = deserialize_int(raw_buf);
@@ -230,9 +233,9 @@ namespace unreal_debugger::serialization::events
             watch_type_{type}
         {}
 
-        lock_list(const message& msg) : event{ event_kind::lock_list }
+        lock_list(const message_view& msg) : event{ event_kind::lock_list }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
             event_kind k = deserialize_event_kind(raw_buf);
             assert(k == event_kind::lock_list);
             watch_type_ = deserialize_int(raw_buf);
@@ -270,9 +273,9 @@ namespace unreal_debugger::serialization::events
         unlock_list(const unlock_list&) = delete;
         unlock_list(unlock_list&&) = default;
 
-        unlock_list(const message& msg) : event{ event_kind::unlock_list }
+        unlock_list(const message_view& msg) : event{ event_kind::unlock_list }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
             event_kind k = deserialize_event_kind(raw_buf);
             assert(k == event_kind::unlock_list);
             watch_type_ = deserialize_int(raw_buf);
@@ -327,9 +330,9 @@ namespace unreal_debugger::serialization::events
             line_number_{ line }
         {}
 
-        add_breakpoint(const message& msg) : event{ event_kind::add_breakpoint }
+        add_breakpoint(const message_view& msg) : event{ event_kind::add_breakpoint }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
             event_kind k = deserialize_event_kind(raw_buf);
             assert(k == event_kind::add_breakpoint);
             class_name_ = deserialize_string(raw_buf);
@@ -367,9 +370,9 @@ namespace unreal_debugger::serialization::events
             line_number_{ line }
         {}
 
-        remove_breakpoint(const message& msg) : event{ event_kind::remove_breakpoint }
+        remove_breakpoint(const message_view& msg) : event{ event_kind::remove_breakpoint }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
             event_kind k = deserialize_event_kind(raw_buf);
             assert(k == event_kind::remove_breakpoint);
             class_name_ = deserialize_string(raw_buf);
@@ -406,9 +409,9 @@ namespace unreal_debugger::serialization::events
             class_name_{ name }
         {}
 
-        editor_load_class(const message& msg) : event{ event_kind::editor_load_class }
+        editor_load_class(const message_view& msg) : event{ event_kind::editor_load_class }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
             event_kind k = deserialize_event_kind(raw_buf);
             assert(k == event_kind::editor_load_class);
             class_name_ = deserialize_string(raw_buf);
@@ -442,9 +445,9 @@ namespace unreal_debugger::serialization::events
             highlight_ { highlight }
         {}
 
-        editor_goto_line(const message& msg) : event{ event_kind::editor_goto_line }
+        editor_goto_line(const message_view& msg) : event{ event_kind::editor_goto_line }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
             event_kind k = deserialize_event_kind(raw_buf);
             assert(k == event_kind::editor_goto_line);
             line_number_ = deserialize_int(raw_buf);
@@ -481,9 +484,9 @@ namespace unreal_debugger::serialization::events
             text_{ text }
         {}
 
-        add_line_to_log(const message& msg) : event{ event_kind::add_line_to_log }
+        add_line_to_log(const message_view& msg) : event{ event_kind::add_line_to_log }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
             event_kind k = deserialize_event_kind(raw_buf);
             assert(k == event_kind::add_line_to_log);
             text_ = deserialize_string(raw_buf);
@@ -514,9 +517,9 @@ namespace unreal_debugger::serialization::events
         call_stack_clear() : event{ event_kind::call_stack_clear }
         {}
 
-        call_stack_clear(const message& msg) : event{ event_kind::call_stack_clear }
+        call_stack_clear(const message_view& msg) : event{ event_kind::call_stack_clear }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
             event_kind k = deserialize_event_kind(raw_buf);
             assert(k == event_kind::call_stack_clear);
             verify_message(msg, raw_buf);
@@ -535,15 +538,27 @@ namespace unreal_debugger::serialization::events
             entry_{ str }
         {}
 
-        call_stack_add(const message& msg) : event{ event_kind::call_stack_add }
+        call_stack_add(const message_view& msg) : event{ event_kind::call_stack_add }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
             event_kind k = deserialize_event_kind(raw_buf);
             assert(k == event_kind::call_stack_add);
             entry_ = deserialize_string(raw_buf);
             verify_message(msg, raw_buf);
         }
 
+        // Read the entry in place in the message buffer. Call stacks arrive as a flood of these, so the
+        // adapter parses them straight from its read buffer rather than copying each entry first.
+        static std::string_view entry_view(const message_view& msg)
+        {
+            char* raw_buf = msg.buf_;
+            event_kind k = deserialize_event_kind(raw_buf);
+            assert(k == event_kind::call_stack_add);
+            std::string_view entry = deserialize_string_view(raw_buf);
+            verify_message(msg, raw_buf);
+            return entry;
+        }
+
         virtual message serialize() const
         {
             message msg;
@@ -570,9 +585,9 @@ namespace unreal_debugger::serialization::events
             object_name_{ str }
         {}
 
-        set_current_object_name(const message& msg) : event{ event_kind::set_current_object_name }
+        set_current_object_name(const message_view& msg) : event{ event_kind::set_current_object_name }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
             event_kind k = deserialize_event_kind(raw_buf);
             assert(k == event_kind::set_current_object_name);
             object_name_ = deserialize_string(raw_buf);
@@ -603,9 +618,9 @@ namespace unreal_debugger::serialization::events
         terminated() : event{ event_kind::terminated }
         {}
 
-        terminated(const message& msg) : event{ event_kind::terminated }
+        terminated(const message_view& msg) : event{ event_kind::terminated }
         {
-            char* raw_buf = msg.buf_.get();
+            char* raw_buf = msg.buf_;
             event_kind k = deserialize_event_kind(raw_buf);
             assert(k == event_kind::terminated);
             verify_message(msg, raw_buf);
@@ -616,4 +631,125 @@ namespace unreal_debugger::serialization::events
             return serialize_empty_message();
         }
     };
+
+    // Not an Unreal API: sent by the interface when it resumes Unreal at the debugger's request.
+    // Everything sent before it belongs to the stop that was just left.
+    struct resumed : event
+    {
+        resumed() : event{ event_kind::resumed }
+        {}
+
+        resumed(const message_view& msg) : event{ event_kind::resumed }
+        {
+            char* raw_buf = msg.buf_;
+            event_kind k = deserialize_event_kind(raw_buf);
+            assert(k == event_kind::resumed);
+            verify_message(msg, raw_buf);
+        }
+
+        virtual message serialize() const
+        {
+            return serialize_empty_message();
+        }
+    };
+
+    // Not an Unreal API: the interface sends the call stack as one of these in place of a
+    // call_stack_clear and a call_stack_add for every frame.
+    //
+    // Between stops the frames at the bottom of the stack are usually the same as they were at the
+    // last stop, so only the frames that changed are sent. Entries are in the order Unreal sends them,
+    // bottom-most first. The new stack is the first 'prefix_' entries of the previous call_stack_delta's
+    // stack followed by 'entries_'. A delta with a prefix of 0 carries the whole stack.
+    struct call_stack_delta : event
+    {
+        call_stack_delta(int prefix, std::vector<std::string> entries) :
+            event{ event_kind::call_stack_delta },
+            prefix_{ prefix },
+            entries_{ std::move(entries) }
+        {}
+
+        call_stack_delta(const message_view& msg) : event{ event_kind::call_stack_delta }
+        {
+            view v{ msg };
+            prefix_ = v.prefix_;
+            entries_.assign(v.entries_.begin(), v.entries_.end());
+        }
+
+        // The delta read in place in the message buffer. The entries are only valid for as long as the
+        // buffer is.
+        struct view
+        {
+            view(const message_view& msg)
+            {
+                char* raw_buf = msg.buf_;
+                event_kind k = deserialize_event_kind(raw_buf);
+                assert(k == event_kind::call_stack_delta);
+                prefix_ = deserialize_int(raw_buf);
+                int count = deserialize_int(raw_buf);
+                entries_.reserve(count);
+
+                for (int i = 0; i < count; ++i)
+                {
+                    entries_.push_back(deserialize_string_view(raw_buf));
+                }
+
+                verify_message(msg, raw_buf);
+            }
+
+            int prefix_;
+            std::vector<std::string_view> entries_;
+        };
+
+        virtual message serialize() const
+        {
+            message msg;
+            msg.len_ =
+                sizeof(event_kind)      // kind field
+                + sizeof(int)           // prefix
+                + sizeof(int)           // entry count
+                ;
+
+            for (const std::string& entry : entries_)
+            {
+                msg.len_ += serialized_length(entry);
+            }
+
+            msg.buf_ = std::make_unique<char[]>(msg.len_);
+            char* raw_buf = msg.buf_.get();
+            serialize_event_kind(raw_buf, kind_);
+            serialize_int(raw_buf, prefix_);
+            serialize_int(raw_buf, static_cast<int>(entries_.size()));
+            for (const std::string& entry : entries_)
+            {
+                serialize_string(raw_buf, entry);
+            }
+
+            verify_message(msg, raw_buf);
+            return msg;
+        }
+
+        int prefix_;
+        std::vector<std::string> entries_;
+    };
+
+    // Not an Unreal API: sent by the interface when Unreal starts to describe a new stop, ahead of
+    // everything else about it. The call stack follows before any watches.
+    struct stop_begin : event
+    {
+        stop_begin() : event{ event_kind::stop_begin }
+        {}
+
+        stop_begin(const message_view& msg) : event{ event_kind::stop_begin }
+        {
+            char* raw_buf = msg.buf_;
+            event_kind k = deserialize_event_kind(raw_buf);
+            assert(k == event_kind::stop_begin);
+            verify_message(msg, raw_buf);
+        }
+
+        virtual message serialize() const
+        {
+            return serialize_empty_message();
+        }
+    };
 }
\ No newline at end of file
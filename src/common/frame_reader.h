@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/error.hpp>
+
+#include "message.h"
+
+namespace unreal_debugger::serialization
+{
+    // Reads framed messages from a stream and dispatches them to a handler.
+    //
+    // Each message on the wire is a 4 byte length header followed by that many bytes of body.
+    // Rather than issuing one read for the header and another for the body, the reader pulls
+    // whatever is available from the socket into one large buffer with 'async_read_some' and
+    // then dispatches every complete frame in that buffer before reading again. When many small
+    // messages are waiting in the socket buffer (e.g. the flood of events when Unreal breaks)
+    // this turns two reads and two handler hops per message into one read for the whole batch.
+    //
+    // Frames are dispatched in place as views into the read buffer, so the handler must be
+    // finished with the message before it returns. A frame that is only partially received
+    // stays where it is while there is room after it to receive the rest. Only when the buffer
+    // runs out of room is the partial frame moved to the front, and only when a single frame is
+    // larger than the whole buffer is the buffer grown to fit it. The larger buffer is kept for
+    // subsequent reads.
+    //
+    // The reader is only used from the single IO thread that services the stream.
+    template <typename Stream>
+    class frame_reader
+    {
+    public:
+        using frame_handler = std::function<void(const message_view&)>;
+        using error_handler = std::function<void(const boost::system::error_code&)>;
+
+        static constexpr std::size_t default_capacity = 64 * 1024;
+        static constexpr std::size_t header_size = sizeof(int);
+
+        frame_reader(Stream& stream, frame_handler on_frame, error_handler on_error, std::size_t capacity = default_capacity) :
+            stream_{ stream },
+            on_frame_{ std::move(on_frame) },
+            on_error_{ std::move(on_error) },
+            buf_{ std::make_unique<char[]>(capacity) },
+            capacity_{ capacity }
+        {}
+
+        // Begin reading. Reading continues until an error occurs. If an owner is given, every
+        // pending read holds a reference to it so the reader (and whatever contains it) stays
+        // alive until the last read completes.
+        void start(std::shared_ptr<void> owner = {})
+        {
+            read_more(std::move(owner));
+        }
+
+    private:
+
+        void read_more(std::shared_ptr<void> owner)
+        {
+            stream_.async_read_some(boost::asio::buffer(buf_.get() + end_, capacity_ - end_), [this, owner](const boost::system::error_code& ec, std::size_t len) {
+                if (ec)
+                {
+                    on_error_(ec);
+                    return;
+                }
+
+                end_ += len;
+
+                if (!dispatch_frames())
+                {
+                    on_error_(boost::asio::error::invalid_argument);
+                    return;
+                }
+
+                read_more(owner);
+            });
+        }
+
+        // Dispatch every complete frame in the buffer and make room for the next read.
+        // Returns false if the stream contains a malformed frame.
+        bool dispatch_frames()
+        {
+            while (end_ - begin_ >= header_size)
+            {
+                int len;
+                memcpy(&len, buf_.get() + begin_, header_size);
+                if (len < 0)
+                {
+                    return false;
+                }
+
+                std::size_t frame_size = header_size + len;
+                if (end_ - begin_ < frame_size)
+                {
+                    // The rest of this frame has not arrived yet. Make sure there is room to receive it.
+                    make_room(frame_size);
+                    return true;
+                }
+
+                on_frame_(message_view{ buf_.get() + begin_ + header_size, len });
+                begin_ += frame_size;
+            }
+
+            if (begin_ == end_)
+            {
+                // Everything has been consumed, start over at the front.
+                begin_ = end_ = 0;
+            }
+            else
+            {
+                // A partial header: make sure there is room for at least the header.
+                make_room(header_size);
+            }
+            return true;
+        }
+
+        // Ensure there is space in the buffer to hold a frame of 'frame_size' bytes starting at the
+        // current read position.
+        void make_room(std::size_t frame_size)
+        {
+            if (capacity_ - begin_ >= frame_size)
+            {
+                // The frame fits where it is.
+                return;
+            }
+
+            std::size_t pending = end_ - begin_;
+
+            if (frame_size > capacity_)
+            {
+                // This frame is larger than the entire buffer: move it into a new buffer large enough to hold it.
+                auto new_buf = std::make_unique<char[]>(frame_size);
+                memcpy(new_buf.get(), buf_.get() + begin_, pending);
+                buf_ = std::move(new_buf);
+                capacity_ = frame_size;
+            }
+            else
+            {
+                // Move the partial frame to the front of the buffer.
+                memmove(buf_.get(), buf_.get() + begin_, pending);
+            }
+
+            begin_ = 0;
+            end_ = pending;
+        }
+
+        Stream& stream_;
+        frame_handler on_frame_;
+        error_handler on_error_;
+
+        // The read buffer. Bytes in [begin_, end_) have been received but not yet dispatched.
+        std::unique_ptr<char[]> buf_;
+        std::size_t capacity_;
+        std::size_t begin_ = 0;
+        std::size_t end_ = 0;
+    };
+}
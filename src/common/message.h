@@ -1,8 +1,15 @@
 
 #pragma once
 
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
 #include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
 
 namespace unreal_debugger::serialization
 {
@@ -22,7 +29,46 @@ namespace unreal_debugger::serialization
         int len_;
     };
 
-    // A very simple thread-safe wrapper around a deque of messages that exposes
+    // A serialized message shared between several consumers, e.g. an event that is fanned
+    // out to more than one connection. The message is serialized once and the buffer is freed
+    // when the last consumer is done with it.
+    using shared_message = std::shared_ptr<const message>;
+
+    // A non-owning view of a serialized message. Messages are deserialized from views so
+    // that the receiving side can decode them in place in its read buffer without copying
+    // each message into its own allocation first.
+    struct message_view
+    {
+        message_view(char* buf, int len) : buf_{ buf }, len_{ len }
+        {}
+
+        message_view(const message& msg) : buf_{ msg.buf_.get() }, len_{ msg.len_ }
+        {}
+
+        char* buf_;
+        int len_;
+    };
+
+    // Counts how often, and for how long in total, pushes onto a queue had to wait for its lock.
+    struct lock_wait_stats
+    {
+        std::atomic<std::uint64_t> pushes = 0;
+        std::atomic<std::uint64_t> contended = 0;
+        std::atomic<std::uint64_t> wait_ns = 0;
+        std::atomic<std::uint64_t> max_wait_ns = 0;
+
+        void record_wait(std::uint64_t ns)
+        {
+            ++contended;
+            wait_ns += ns;
+
+            std::uint64_t max = max_wait_ns;
+            while (ns > max && !max_wait_ns.compare_exchange_weak(max, ns))
+                ;
+        }
+    };
+
+    // A very simple thread-safe wrapper around a deque of elements that exposes
     // a limited interface that the debugger interface and client need.
     //
     // The basic model of both the debugger interface and the debugger client
@@ -60,12 +106,16 @@ namespace unreal_debugger::serialization
     // at the same time as the push/pop and while the lock is held, it is guaranteed that there
     // will always be a handler registered for the front-most element of the queue, but no
     // more than that.
-    class locked_message_queue
+    //
+    // Alternatively the consumer may 'take_all' elements at once, which leaves the queue empty.
+    // The next push then returns true and the producer must register a new handler as above.
+    template <typename T>
+    class locked_queue
     {
     public:
 
-        // Peek the top-most message.
-        const message& top()
+        // Peek the top-most element.
+        const T& top()
         {
             std::lock_guard<std::mutex> lock(mu_);
             return queue_.front();
@@ -87,7 +137,7 @@ namespace unreal_debugger::serialization
         // true if the queue was empty before this element was added.
         // If this function returns 'true' the calling producer is
         // responsible for registering a handler to process this element.
-        bool push(message&& msg)
+        bool push(T&& msg)
         {
             std::lock_guard<std::mutex> lock(mu_);
             bool empty = queue_.empty();
@@ -95,17 +145,47 @@ namespace unreal_debugger::serialization
             return empty;
         }
 
+        // As push(), but also record in 'stats' how long the producer waited for the lock. The
+        // clock is only read if the lock is already held.
+        bool push(T&& msg, lock_wait_stats& stats)
+        {
+            ++stats.pushes;
+            std::unique_lock<std::mutex> lock(mu_, std::try_to_lock);
+            if (!lock.owns_lock())
+            {
+                auto start = std::chrono::steady_clock::now();
+                lock.lock();
+                auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+                stats.record_wait(static_cast<std::uint64_t>(waited.count()));
+            }
+
+            bool empty = queue_.empty();
+            queue_.push_back(std::move(msg));
+            return empty;
+        }
+
+        // Remove and return every element in the queue.
+        std::deque<T> take_all()
+        {
+            std::deque<T> elements;
+            std::lock_guard<std::mutex> lock(mu_);
+            std::swap(elements, queue_);
+            return elements;
+        }
+
     private:
-        std::deque<message> queue_;
+        std::deque<T> queue_;
         std::mutex mu_;
     };
 
+    using locked_message_queue = locked_queue<message>;
+
     // Verify that a message has been completely serialized or deserialized:
     // the position of the raw buffer 'buf' should be msg.len_ bytes from the
     // start of msg.buf_.
-    inline void verify_message(const message& msg, char* buf)
+    inline void verify_message(const message_view& msg, char* buf)
     {
-        assert(msg.len_ == (buf - msg.buf_.get()));
+        assert(msg.len_ == (buf - msg.buf_));
     }
 
     // Serialization helpers
@@ -191,4 +271,17 @@ namespace unreal_debugger::serialization
 
         return str;
     }
+
+    // Deserialize a string as a view into the message buffer, without copying it. The view is only
+    // valid for as long as the buffer is.
+    inline std::string_view deserialize_string_view(char*& buf)
+    {
+        int len = *reinterpret_cast<int*>(buf);
+        buf += sizeof(int);
+
+        std::string_view str(buf, len);
+        buf += len;
+
+        return str;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/asio/basic_socket_acceptor.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/generic/stream_protocol.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/system/system_error.hpp>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "environment.h"
+
+namespace unreal_debugger::transport
+{
+    // The debugger interface and the debugger adapter talk to each other over a byte stream
+    // using the framing described in message.h. The stream is either a loopback TCP connection
+    // (the default) or a local IPC socket (AF_UNIX). A local socket skips the loopback TCP stack
+    // entirely and is named by a path rather than a port, so several games can be debugged at
+    // the same time without fighting over the port.
+    //
+    // Both ends use the generic stream protocol so the rest of the networking code is the same
+    // regardless of which transport was selected. Windows supports AF_UNIX sockets from Windows 10
+    // 1803 onwards; asio only enables them when the SDK it is built against has them.
+    //
+    // The transport is selected with environment variables, which must agree between the game
+    // and the editor:
+    //
+    // UNREAL_DEBUGGER_TRANSPORT: "tcp" (default) or "local"
+    // UNREAL_DEBUGGER_PORT: The TCP port to use (default 10077)
+    // UNREAL_DEBUGGER_SOCKET: The path of the local socket (default <temp dir>/unrealscript-debugger-<pid>.sock,
+    //                         where <pid> is the game's process id)
+    //
+    // Each game listens on a socket of its own by default. Without a path the adapter connects to the
+    // newest of them that is still listening: see socket_candidates.
+    using protocol = boost::asio::generic::stream_protocol;
+    using acceptor = boost::asio::basic_socket_acceptor<protocol>;
+
+    enum class transport_kind
+    {
+        tcp,
+        local
+    };
+
+    static const int default_port = 10077;
+
+    struct config
+    {
+        transport_kind kind = transport_kind::tcp;
+        int port = default_port;
+        std::string path;
+    };
+
+    static const char socket_prefix[] = "unrealscript-debugger-";
+    static const char socket_suffix[] = ".sock";
+
+    inline int current_process_id()
+    {
+#ifdef _WIN32
+        return _getpid();
+#else
+        return static_cast<int>(getpid());
+#endif
+    }
+
+    // The path a game listens on when none is configured. It names the game's process, so several
+    // games can listen at once.
+    inline std::string default_socket_path()
+    {
+        std::error_code ec;
+        std::filesystem::path dir = std::filesystem::temp_directory_path(ec);
+        return (dir / (socket_prefix + std::to_string(current_process_id()) + socket_suffix)).string();
+    }
+
+    // The local sockets games may be listening on when no path is configured, newest first. Some may be
+    // left behind by games that have gone.
+    inline std::vector<std::string> socket_candidates()
+    {
+        namespace fs = std::filesystem;
+
+        std::error_code ec;
+        std::vector<std::pair<fs::file_time_type, std::string>> found;
+        for (const fs::directory_entry& entry : fs::directory_iterator(fs::temp_directory_path(ec), ec))
+        {
+            std::string name = entry.path().filename().string();
+            if (name.size() > sizeof(socket_prefix) + sizeof(socket_suffix) - 2
+                && name.compare(0, sizeof(socket_prefix) - 1, socket_prefix) == 0
+                && name.compare(name.size() - (sizeof(socket_suffix) - 1), std::string::npos, socket_suffix) == 0)
+            {
+                std::error_code time_ec;
+                found.emplace_back(entry.last_write_time(time_ec), entry.path().string());
+            }
+        }
+
+        std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+        std::vector<std::string> paths;
+        for (auto& [time, path] : found)
+        {
+            paths.push_back(std::move(path));
+        }
+        return paths;
+    }
+
+    // Build the transport config from the environment. A local socket's path is left empty if it isn't
+    // set: the listening side uses default_socket_path(), and the connecting side searches for one.
+    inline config config_from_environment()
+    {
+        config cfg;
+
+        if (auto kind = get_env("UNREAL_DEBUGGER_TRANSPORT"); kind && *kind == "local")
+        {
+            cfg.kind = transport_kind::local;
+        }
+
+        cfg.port = get_env_int("UNREAL_DEBUGGER_PORT", default_port);
+        cfg.path = get_env("UNREAL_DEBUGGER_SOCKET").value_or("");
+        return cfg;
+    }
+
+    // Build the endpoint for the given config. The listening side (the interface) binds TCP to
+    // any address, the connecting side (the adapter) connects to loopback.
+    inline protocol::endpoint make_endpoint(const config& cfg, bool listening)
+    {
+        using tcp = boost::asio::ip::tcp;
+
+        switch (cfg.kind)
+        {
+        case transport_kind::tcp:
+            if (listening)
+            {
+                return tcp::endpoint(tcp::v4(), cfg.port);
+            }
+            return tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), cfg.port);
+
+        case transport_kind::local:
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+            return boost::asio::local::stream_protocol::endpoint(cfg.path);
+#else
+            throw std::runtime_error("Local socket transport is not supported by this build");
+#endif
+        }
+
+        throw std::runtime_error("Unknown transport kind");
+    }
+
+    // Open, bind, and start listening on an acceptor for the given config. A local socket leaves
+    // its path behind when its listener goes away. A path that nothing accepts connections on is such a
+    // stale socket and is removed first, but if something is still listening on it the listen fails with
+    // address_in_use, as it would for a TCP port in use.
+    inline void listen(acceptor& listener, config cfg)
+    {
+        if (cfg.kind == transport_kind::local)
+        {
+            if (cfg.path.empty())
+            {
+                cfg.path = default_socket_path();
+            }
+
+            std::error_code ec;
+            if (std::filesystem::exists(cfg.path, ec))
+            {
+                protocol::socket probe(listener.get_executor());
+                boost::system::error_code connect_ec;
+                probe.connect(make_endpoint(cfg, false), connect_ec);
+                if (!connect_ec)
+                {
+                    throw boost::system::system_error(boost::asio::error::address_in_use, cfg.path);
+                }
+                std::filesystem::remove(cfg.path, ec);
+            }
+        }
+
+        protocol::endpoint ep = make_endpoint(cfg, true);
+
+        listener.open(ep.protocol());
+        if (cfg.kind == transport_kind::tcp)
+        {
+            listener.set_option(boost::asio::socket_base::reuse_address(true));
+        }
+        listener.bind(ep);
+        listener.listen();
+    }
+}
@@ -16,12 +16,41 @@ namespace unreal_debugger::interface
 namespace serialization = unreal_debugger::serialization;
 namespace commands = serialization::commands;
 
+// Dispatch a command to Unreal.
+//
+// Unreal usually answers a command by calling straight back into the interface from inside the callback, on
+// this (the IO) thread: changing frames, for instance, produces a class, a line, three watch lists and an
+// object name. Rather than passing each of these through the send queue and writing them one at a time,
+// the events produced during the dispatch are collected and handed to the connections in a single batch
+// once the callback returns.
+void debugger_service::dispatch_command(const serialization::message_view& msg)
+{
+    struct dispatch_scope
+    {
+        debugger_service& service;
+
+        dispatch_scope(debugger_service& svc) : service{ svc }
+        {
+            service.dispatch_thread_ = std::this_thread::get_id();
+        }
+
+        ~dispatch_scope()
+        {
+            service.dispatch_thread_ = std::thread::id{};
+            service.flush_events();
+        }
+    };
+
+    dispatch_scope scope{ *this };
+    run_command(msg);
+}
+
 // Given the message received over the wire, deserialize it into structured form and
 // call the appropriate debugger service function to re-encode it as a string for the
 // unreal callback.
-void debugger_service::dispatch_command(const serialization::message& msg)
+void debugger_service::run_command(const serialization::message_view& msg)
 {
-    char* buf = msg.buf_.get();
+    char* buf = msg.buf_;
     commands::command_kind k = serialization::deserialize_command_kind(buf);
     switch (k)
     {
@@ -40,6 +69,7 @@ void debugger_service::dispatch_command(const serialization::message& msg)
     case commands::command_kind::step_over: step_over(commands::step_over{ msg }); return;
     case commands::command_kind::step_out_of: step_out_of(commands::step_out_of{ msg }); return;
     case commands::command_kind::toggle_watch_info: toggle_watch_info(commands::toggle_watch_info{ msg }); return;
+    case commands::command_kind::resume: resume(commands::resume{ msg }); return;
     }
 
     throw std::runtime_error("Unexpected command type");
@@ -80,6 +110,8 @@ void debugger_service::clear_watch(const commands::clear_watch& cmd)
 
 void debugger_service::change_stack(const commands::change_stack& cmd)
 {
+    shadow_.change_frame(cmd.stack_id_);
+
     std::stringstream stream;
     stream << "changestack " << cmd.stack_id_;
     callback_function(stream.str().c_str());
@@ -111,23 +143,46 @@ void debugger_service::stop_debugging(const commands::stop_debugging& cmd)
     callback_function("stopdebugging");
 }
 
+// Unreal is about to resume execution. Hand out everything produced during the stop so far, so it is
+// recorded against this stop and not the next one, and then forget the stop. The 'resumed' event marks
+// the boundary for the debugger, which may have stopped caring about the old stop some time ago.
+//
+// 'resumed' must reach the connections before Unreal is resumed. Otherwise Unreal may hit the next
+// breakpoint before the dispatch ends, and flushing the dispatch would deliver the whole new stop ahead
+// of the 'resumed' that the debugger needs in order to accept it.
+//
+// This runs on the IO thread while Unreal's thread may still be describing the stop, so the event is
+// queued directly: send_event's call stack and watch list state belong to Unreal's thread.
+void debugger_service::resuming()
+{
+    flush_events();
+    shadow_.resume();
+    in_stop_ = false;
+    queue_event(std::make_shared<const serialization::message>(events::resumed{}.serialize()));
+    flush_events();
+}
+
 void debugger_service::go(const commands::go& cmd)
 {
+    resuming();
     callback_function("go");
 }
 
 void debugger_service::step_into(const commands::step_into& cmd)
 {
+    resuming();
     callback_function("stepinto");
 }
 
 void debugger_service::step_over(const commands::step_over& cmd)
 {
+    resuming();
     callback_function("stepover");
 }
 
 void debugger_service::step_out_of(const commands::step_out_of& cmd)
 {
+    resuming();
     callback_function("stepoutof");
 }
 
@@ -153,5 +208,40 @@ void debugger_service::toggle_watch_info(const commands::toggle_watch_info& cmd)
     }
 }
 
+// resume is a pseudo command that bundles the bookkeeping the debugger does every time it resumes Unreal
+// with the resume itself: it is expanded here into the individual Unreal commands.
+void debugger_service::resume(const commands::resume& cmd)
+{
+    if (cmd.flags_ & commands::resume_flags::clear_watches)
+    {
+        callback_function("clearwatch");
+    }
+
+    // Nobody will look at the top frame's watches before Unreal moves on, so don't send them.
+    if (cmd.flags_ & commands::resume_flags::reset_frame)
+    {
+        send_watch_info_ = false;
+        shadow_.change_frame(0);
+        callback_function("changestack 0");
+    }
+
+    // Unreal always resumes with watch info on.
+    if (cmd.flags_ & (commands::resume_flags::enable_watch_info | commands::resume_flags::reset_frame))
+    {
+        send_watch_info_ = true;
+    }
+
+    resuming();
+
+    switch (cmd.resume_kind_)
+    {
+    case commands::resume_kind::go: callback_function("go"); return;
+    case commands::resume_kind::step_into: callback_function("stepinto"); return;
+    case commands::resume_kind::step_over: callback_function("stepover"); return;
+    case commands::resume_kind::step_out_of: callback_function("stepoutof"); return;
+    }
+
+    throw std::runtime_error("Unexpected resume kind");
 }
 
+}
@@ -1,4 +1,6 @@
 
+#include <algorithm>
+
 #include "service.h"
 
 namespace unreal_debugger::interface
@@ -113,8 +115,22 @@ void debugger_service::remove_breakpoint(const char* class_name, int line_number
     send_event(events::remove_breakpoint{ class_name, line_number });
 }
 
+// EditorLoadClass is the first thing Unreal reports about a stop, so if Unreal isn't already stopped
+// this is the start of a new one. Tell the client straight away so that it can start asking about the
+// stop while Unreal is still describing it. The watch lists Unreal sends next can be very large, and
+// are held back until the call stack has been sent: the call stack is all the client needs to show
+// where Unreal stopped. See send_event.
 void debugger_service::editor_load_class(const char* class_name)
 {
+    if (!in_stop_.exchange(true))
+    {
+        send_event(events::stop_begin{});
+
+        // Anything still held back is from the last stop, whose frames are gone.
+        deferred_watches_.clear();
+        defer_watches_ = true;
+    }
+
     send_event(events::editor_load_class{ class_name });
 }
 
@@ -125,17 +141,37 @@ void debugger_service::editor_goto_line(int line_number, int highlight)
 
 void debugger_service::add_line_to_log(const char* text)
 {
+    // Log lines aren't part of the shadow state, so there's no point serializing them if nobody is listening.
+    if (connection_count_ == 0)
+        return;
+
     send_event(events::add_line_to_log{ text });
 }
 
+// The call stack is collected here rather than being sent an entry at a time, and is sent as a single
+// call_stack_delta against the previous stack once Unreal moves on to its next event. See send_event.
 void debugger_service::call_stack_clear()
 {
-    send_event(events::call_stack_clear{});
+    building_call_stack_ = true;
+    new_call_stack_.clear();
 }
 
 void debugger_service::call_stack_add(const char* entry)
 {
-    send_event(events::call_stack_add{ entry });
+    new_call_stack_.emplace_back(entry);
+}
+
+// Send the collected call stack. Only the entries that differ from the stack that was sent last are
+// included.
+void debugger_service::send_call_stack()
+{
+    building_call_stack_ = false;
+
+    auto [prev_it, new_it] = std::mismatch(call_stack_.begin(), call_stack_.end(), new_call_stack_.begin(), new_call_stack_.end());
+    int prefix = static_cast<int>(new_it - new_call_stack_.begin());
+    send_event(events::call_stack_delta{ prefix, std::vector<std::string>(new_it, new_call_stack_.end()) });
+
+    std::swap(call_stack_, new_call_stack_);
 }
 
 void debugger_service::set_current_object_name(const char* object_name)
@@ -1,9 +1,16 @@
 // service.cpp
 //
 
+#include <algorithm>
+#include <future>
 #include <thread>
 #include <boost/asio.hpp>
 
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "environment.h"
 #include "service.h"
 
 namespace unreal_debugger::interface
@@ -14,9 +21,14 @@ boost::asio::io_context ios;
 std::thread worker;
 std::atomic<service_state> state;
 
-namespace asio = boost::asio;
+// In poll mode there is no worker thread: IO is done by whichever thread polls for it. See poll_io.
+bool poll_mode = false;
+static std::atomic<bool> polling = false;
 
-static const int default_port = 10077;
+// The thread currently running IO: the worker, or in poll mode the thread that is polling.
+static std::atomic<std::thread::id> io_thread;
+
+namespace asio = boost::asio;
 
 debugger_service::debugger_service() :
     watch_indices_{1, 1, 1}
@@ -24,11 +36,10 @@ debugger_service::debugger_service() :
 
 void debugger_service::start()
 {
-    // TODO Add environment var for port override?
-    int port = default_port;
-
-    // Create the acceptor to listen for connections.
-    acceptor_ = std::make_unique<tcp::acceptor>(ios, tcp::endpoint(tcp::v4(), port));
+    // Create the acceptor to listen for connections on the configured transport.
+    transport::config cfg = transport::config_from_environment();
+    acceptor_ = std::make_unique<transport::acceptor>(ios);
+    transport::listen(*acceptor_, cfg);
 
     // We are now in the disconnected state: the debugger service is up and running, but not yet
     // connected.
@@ -38,6 +49,25 @@ void debugger_service::start()
     accept_connection();
 }
 
+// Print how much time Unreal's thread has lost waiting to queue events, to help judge the effect of
+// the worker thread's scheduling settings. Only done if UNREAL_DEBUGGER_LOCK_STATS is set to a non-zero
+// number, to keep the game's log clean otherwise.
+void debugger_service::report_send_lock_stats()
+{
+    if (get_env_int("UNREAL_DEBUGGER_LOCK_STATS", 0) == 0)
+    {
+        return;
+    }
+
+    std::uint64_t pushes = send_lock_stats_.pushes;
+    std::uint64_t contended = send_lock_stats_.contended;
+    printf("Debugger send queue: %llu events, %llu waited for the lock, %.3f ms waiting in total, %.3f ms longest wait\n",
+        static_cast<unsigned long long>(pushes),
+        static_cast<unsigned long long>(contended),
+        send_lock_stats_.wait_ns / 1e6,
+        send_lock_stats_.max_wait_ns / 1e6);
+}
+
 // Request a stop, usually because of an error.
 //
 // We just set a flag, which will be tested the next time we enter the API from Unreal.
@@ -55,6 +85,27 @@ void debugger_service::shutdown()
 {
     // Send a 'terminated' event to the debugger client so it knows unreal has stopped the debugger.
     send_event(events::terminated{});
+    report_send_lock_stats();
+
+    // The service is about to be torn down, which stops the IO thread. Make sure the event has been handed to
+    // the connections before that happens. Don't wait forever: if the IO thread is stuck we're shutting down anyway.
+    if (std::this_thread::get_id() == io_thread.load())
+    {
+        flush_events();
+    }
+    else
+    {
+        auto flushed = std::make_shared<std::promise<void>>();
+        asio::post(ios, [this, flushed]() {
+            flush_events();
+            flushed->set_value();
+        });
+        if (poll_mode)
+        {
+            poll_io();
+        }
+        flushed->get_future().wait_for(std::chrono::seconds(1));
+    }
 }
 
 // Log an error message to the console and stop the current debugger.
@@ -68,138 +119,463 @@ void debugger_service::fatal_error(const char* msg, ...)
     stop();
 }
 
-// Receive and process the next command message from the client. Since there is only ever a single IO thread reading
-// these messages access to the next message object does not need to be synchronized.
-void debugger_service::receive_next_message()
+// Asynchronously wait for the next connection. The first connection becomes the controlling connection,
+// and any made while it is connected are observers.
+//
+// The listener stays up for the life of the service, so a client that drops can simply reconnect. Every
+// new connection is first sent the shadow state in a single burst so that it starts out knowing everything
+// the previous client did.
+void debugger_service::accept_connection()
 {
-    // Register a handler to read the command header.
-    async_read(*socket_, boost::asio::buffer(&next_command_.len_, 4), [this](const boost::system::error_code& ec, std::size_t len) {
-        if (ec)
+    acceptor_->async_accept([this](const boost::system::error_code& ec, protocol::socket socket) {
+        if (ec == asio::error::operation_aborted || !acceptor_->is_open())
         {
-            fatal_error("Receiving command header error: %s\n", ec.message().c_str());
             return;
         }
-        if (len != 4)
+
+        // A failed accept (e.g. out of file handles, or a client that gave up while connecting) doesn't
+        // affect the connections already made. Try again shortly, rather than straight away in case the
+        // cause hasn't gone yet.
+        if (ec)
         {
-            fatal_error("Failed to read header.");
+            printf("Debugger: Accepting connection error: %s\n", ec.message().c_str());
+            auto retry = std::make_shared<asio::steady_timer>(ios, std::chrono::milliseconds(100));
+            retry->async_wait([this, retry](const boost::system::error_code& timer_ec) {
+                if (!timer_ec && acceptor_->is_open())
+                {
+                    accept_connection();
+                }
+            });
             return;
         }
 
-        // Allocate the buffer for the command
-        // TODO: Keep any previous buffer here and re-use it if it's big enough instead of re-allocating each read.
-        next_command_.buf_ = std::make_unique<char[]>(next_command_.len_);
+        bool controlling = std::none_of(connections_.begin(), connections_.end(), [](const auto& conn) {
+            return conn->is_controlling();
+        });
 
-        // Register a handler to read the command body
-        async_read(*socket_, boost::asio::buffer(next_command_.buf_.get(), next_command_.len_), [this](const boost::system::error_code& ec, std::size_t len) {
-            if (ec)
-            {
-                printf("Receiving command body error: %s\n", ec.message().c_str());
-                return;
-            }
-            if (len != next_command_.len_)
-            {
-                printf("Failed to read body: read %zu of %d bytes\n", len, next_command_.len_);
-                return;
-            }
+        // Hand out anything still queued first so the shadow state is current: the new connection must
+        // see each event exactly once, either in the resync burst or live.
+        flush_events();
 
-            // Dispatch the command. This must happen on the same IO thread and complete before we return so we can re-use the message space.
-            dispatch_command(next_command_);
+        auto conn = std::make_shared<connection>(*this, std::move(socket), controlling);
+        connections_.push_back(conn);
+        ++connection_count_;
+        conn->send(shadow_.resync());
+        conn->start();
 
-            // Clear out the buffer.
-            next_command_.buf_ = {};
-            next_command_.len_ = 0;
+        if (controlling)
+        {
+            state = service_state::connected;
 
-            // Start async handling for the next message.
-            receive_next_message();
-        });
-    });
-}
+            // A previous client may have left Unreal looking at some other frame. New clients assume the
+            // top-most frame is selected, so switch back to it. The watches for the top frame are already
+            // part of the resync burst, so don't send them again.
+            if (shadow_.current_frame() != 0 && callback_function)
+            {
+                bool send_watch_info = send_watch_info_;
+                send_watch_info_ = false;
+                shadow_.change_frame(0);
+                callback_function("changestack 0");
+                send_watch_info_ = send_watch_info;
+            }
+        }
 
-// Asynchronously wait for the next connection.
-void debugger_service::accept_connection()
-{
-    acceptor_->async_accept([this](const boost::system::error_code& ec, tcp::socket socket) {
-        // We have a new connection.
-        this->socket_ = std::make_unique<tcp::socket>(std::move(socket));
-        state = service_state::connected;
-        this->receive_next_message();
+        // Keep listening.
+        accept_connection();
     });
 }
 
-// Enqueues a message to send to the debugger client. If the queue is
-// currently empty it will also initiate an async send of the message.
-void debugger_service::send_event(const events::event& ev)
+// A connection has failed or been closed by the client. Losing an observer just drops that connection.
+// Losing the controlling connection puts the service back into the disconnected state, ready for the
+// client to reconnect: nothing is torn down.
+void debugger_service::connection_closed(const std::shared_ptr<connection>& conn, const boost::system::error_code& ec)
 {
-    bool is_empty = false;
+    auto it = std::find(connections_.begin(), connections_.end(), conn);
+    if (it == connections_.end())
+    {
+        // Already removed: both the reader and writer can report the same failure.
+        return;
+    }
+
+    connections_.erase(it);
+    --connection_count_;
+    conn->close();
+
+    if (conn->is_controlling())
+    {
+        printf("Debugger client disconnected: %s\n", ec.message().c_str());
+        report_send_lock_stats();
+
+        // The client may have turned off watch info while it was working. The next one will expect it on.
+        send_watch_info_ = true;
 
-    // Serialize and enqueue the next message. If the queue was empty prior to the message
-    // we just enqueued, register a handler to send this message. This actual send will not be serviced
-    // on this thread, but on the IO thread.
-    if (send_queue_.push(ev.serialize()))
+        if (state == service_state::connected)
+        {
+            state = service_state::disconnected;
+        }
+    }
+    else
     {
-        send_next_message();
+        printf("Debugger observer disconnected: %s\n", ec.message().c_str());
     }
 }
 
-// Send the next message over the wire via an async send. The completion handler for
-// this send will schedule the sending of the next message if the queue is not empty
-// when it completes.
-void debugger_service::send_next_message()
+// Enqueues a message to send to the debugger clients. The event is serialized once here and the
+// resulting buffer is shared by every connection.
+void debugger_service::send_event(const events::event& ev)
 {
-    // This must be on the single IO writer thread, so nobody else can be emptying the queue
-    // while we're processing this message. We don't need to lock access to this top element while
-    // we're processing the send.
-    auto&& next_msg = send_queue_.top();
+    // Whatever Unreal sends after the call stack marks its end.
+    if (building_call_stack_ && ev.kind_ != events::event_kind::call_stack_delta)
+    {
+        send_call_stack();
+    }
 
-    // Start the async send of the header for this message.
-    async_write(*socket_, boost::asio::buffer(&next_msg.len_, 4), [this](const boost::system::error_code& ec, std::size_t n) {
-        if (ec)
+    auto msg = std::make_shared<const serialization::message>(ev.serialize());
+
+    // At the start of a stop the watch lists wait for the call stack. Anything after the watches also
+    // releases them, in case Unreal doesn't send a call stack.
+    if (defer_watches_)
+    {
+        switch (ev.kind_)
         {
-            fatal_error("Sending event header error: %s\n", ec.message().c_str());
+        case events::event_kind::clear_a_watch:
+        case events::event_kind::lock_list:
+        case events::event_kind::unlock_list:
+            deferred_watches_.push_back(std::move(msg));
+            return;
+
+        case events::event_kind::call_stack_delta:
+            queue_event(std::move(msg));
+            release_watches();
             return;
+
+        case events::event_kind::set_current_object_name:
+        case events::event_kind::show_dll_form:
+            release_watches();
+            break;
+
+        default:
+            break;
         }
-        if (n != 4)
+    }
+
+    queue_event(std::move(msg));
+}
+
+// Queue a serialized event for the IO thread. If the queue was empty this also schedules a flush on the
+// IO thread, which hands everything queued so far to the connections.
+void debugger_service::queue_event(serialization::shared_message msg)
+{
+    // Unreal is answering a command from inside the callback, on the IO thread. Collect the event to send
+    // with the rest of the answer. See dispatch_command.
+    if (std::this_thread::get_id() == dispatch_thread_.load())
+    {
+        dispatch_events_.push_back(std::move(msg));
+        return;
+    }
+
+    if (send_queue_.push(std::move(msg), send_lock_stats_))
+    {
+        asio::post(ios, [this]() { flush_events(); });
+    }
+
+    // In poll mode, send it now rather than waiting for the next tick of the poll timer.
+    if (poll_mode)
+    {
+        poll_io();
+    }
+}
+
+// Send the watch lists held back at the start of a stop. If Unreal has been resumed in the meantime they
+// are dropped instead: they would arrive after 'resumed' and be taken for the watches of the next stop.
+void debugger_service::release_watches()
+{
+    defer_watches_ = false;
+    if (in_stop_)
+    {
+        for (auto& msg : deferred_watches_)
         {
-            fatal_error("Sending event header truncated: wrote %zu of 4 bytes\n", n);
-            return;
+            queue_event(std::move(msg));
         }
+    }
+    deferred_watches_.clear();
+}
+
+// Hand all queued events to every connection, recording them in the shadow state. This runs on the IO thread.
+void debugger_service::flush_events()
+{
+    deliver(send_queue_.take_all());
+
+    if (!dispatch_events_.empty())
+    {
+        deliver(dispatch_events_);
+        dispatch_events_.clear();
+    }
+}
+
+// Record a batch of events in the shadow state and hand them to every connection. Each connection gets the
+// whole batch at once, so it goes out in a single write.
+template <typename Messages>
+void debugger_service::deliver(const Messages& messages)
+{
+    if (messages.empty())
+    {
+        return;
+    }
+
+    std::vector<std::vector<serialization::shared_message>> batches(connections_.size());
+
+    for (const auto& msg : messages)
+    {
+        shadow_.record(msg);
 
-        // Fetch the top element again so we can send the body
-        auto&& next_msg = send_queue_.top();
+        // A call stack delta is only any use to a connection that has the stack it is relative to. One that
+        // doesn't yet is sent the whole stack instead.
+        char* buf = msg->buf_.get();
+        bool is_call_stack = serialization::deserialize_event_kind(buf) == events::event_kind::call_stack_delta;
 
-        // Start the async send of the message body
-        async_write(*socket_, boost::asio::buffer(next_msg.buf_.get(), next_msg.len_), [this, len = next_msg.len_](boost::system::error_code ec, std::size_t n) {
-            if (ec)
+        for (std::size_t i = 0; i < connections_.size(); ++i)
+        {
+            const auto& conn = connections_[i];
+            if (is_call_stack && !conn->has_call_stack())
             {
-                fatal_error("Sending event body error: %s\n", ec.message().c_str());
-                return;
+                batches[i].push_back(shadow_.call_stack());
+                conn->set_has_call_stack();
             }
-            if (n != len)
+            else
             {
-                fatal_error("Sending event body truncated: wrote %zu of %zu bytes\n", n, len);
-                return;
+                batches[i].push_back(msg);
             }
+        }
+    }
+
+    for (std::size_t i = 0; i < connections_.size(); ++i)
+    {
+        connections_[i]->send(batches[i]);
+    }
+}
 
-            // This message is now complete, pop it from the queue. If the queue is not empty after this pop, register
-            // a new send. Note that the test for emptiness is done while the internal lock is held while popping the
-            // element, so there is no race here with the producer thread: if the queue is empty we must just return.
-            // Nobody can be yet adding anything to the queue, and any thread blocked on the lock must observe the
-            // empty queue and will register the next send handler themselves.
-            if (!send_queue_.pop())
+connection::connection(debugger_service& svc, protocol::socket socket, bool controlling) :
+    service_{ svc },
+    socket_{ std::move(socket) },
+    reader_{ socket_,
+        [this](const serialization::message_view& msg) {
+            // Dispatch the command. This must happen on the same IO thread and complete before we return since the
+            // message is a view into the reader's buffer. Commands from observers are discarded.
+            if (controlling_)
             {
-                send_next_message();
+                service_.dispatch_command(msg);
             }
-        });
+        },
+        [this](const boost::system::error_code& ec) {
+            service_.connection_closed(shared_from_this(), ec);
+        } },
+    controlling_{ controlling }
+{}
+
+void connection::start()
+{
+    reader_.start(shared_from_this());
+}
+
+void connection::close()
+{
+    boost::system::error_code ec;
+    socket_.close(ec);
+}
+
+// Queue a message for this client. If no write is in progress, start one.
+void connection::send(const serialization::shared_message& msg)
+{
+    pending_.push_back(msg);
+
+    if (writing_.empty())
+    {
+        write_pending();
+    }
+}
+
+void connection::send(const std::vector<serialization::shared_message>& msgs)
+{
+    if (msgs.empty())
+    {
+        return;
+    }
+
+    pending_.insert(pending_.end(), msgs.begin(), msgs.end());
+
+    if (writing_.empty())
+    {
+        write_pending();
+    }
+}
+
+// Write every pending message in a single gathered write: the header and body of each message
+// are separate buffers, but they all go out in one operation.
+void connection::write_pending()
+{
+    std::swap(writing_, pending_);
+
+    buffers_.clear();
+    for (const auto& msg : writing_)
+    {
+        buffers_.push_back(asio::buffer(&msg->len_, 4));
+        buffers_.push_back(asio::buffer(msg->buf_.get(), msg->len_));
+    }
+
+    async_write(socket_, buffers_, [this, self = shared_from_this()](const boost::system::error_code& ec, std::size_t) {
+        if (ec)
+        {
+            service_.connection_closed(self, ec);
+            return;
+        }
+
+        // These messages are done. Release our references to them and send anything that was
+        // queued while this write was in progress.
+        writing_.clear();
+        if (!pending_.empty())
+        {
+            write_pending();
+        }
     });
+}
+
+// Apply the scheduling settings from the environment to the worker thread. The worker competes with the
+// game's own threads: raising its priority gets events to the debugger sooner when the machine is busy, and
+// lowering it or confining it to some cores leaves more for the game.
+//
+// UNREAL_DEBUGGER_WORKER_PRIORITY: A Win32 thread priority, -2 (lowest) to 2 (highest).
+// UNREAL_DEBUGGER_WORKER_AFFINITY: A mask of the CPUs the worker may run on, e.g. 0x3 for the first two.
+static void configure_worker_thread()
+{
+    std::optional<std::string> priority = get_env("UNREAL_DEBUGGER_WORKER_PRIORITY");
+    std::optional<std::string> affinity = get_env("UNREAL_DEBUGGER_WORKER_AFFINITY");
+
+#ifdef _WIN32
+    if (priority)
+    {
+        int value = std::clamp(get_env_int("UNREAL_DEBUGGER_WORKER_PRIORITY", 0), THREAD_PRIORITY_LOWEST, THREAD_PRIORITY_HIGHEST);
+        if (!SetThreadPriority(GetCurrentThread(), value))
+        {
+            printf("Debugger: Failed to set worker priority %d (error %lu)\n", value, GetLastError());
+        }
+    }
 
+    if (affinity)
+    {
+        DWORD_PTR mask = static_cast<DWORD_PTR>(std::strtoull(affinity->c_str(), nullptr, 0));
+        if (mask == 0 || SetThreadAffinityMask(GetCurrentThread(), mask) == 0)
+        {
+            printf("Debugger: Failed to set worker affinity %s\n", affinity->c_str());
+        }
+    }
+#else
+    if (priority || affinity)
+    {
+        printf("Debugger: Worker priority and affinity are only supported on Windows\n");
+    }
+#endif
 }
 
 void worker_loop()
 {
+    configure_worker_thread();
+    io_thread = std::this_thread::get_id();
+
     // The main worker loop thread just services ASIO tasks.
     ios.run();
 }
 
+// Poll mode: an alternative to the worker thread, selected with UNREAL_DEBUGGER_IO_MODE=poll.
+//
+// Instead of handing each event to the worker thread and waking it up, the thread that queues an event
+// runs the IO itself there and then: socket writes are started (and on most platforms completed) without
+// leaving Unreal's thread. Commands from the debugger are read the same way, but when Unreal is stopped it
+// doesn't call into the interface at all, so a light timer also polls every few milliseconds
+// (UNREAL_DEBUGGER_POLL_INTERVAL, default 5). This trades the cross-thread wakeup for doing the IO on
+// Unreal's thread; the mode is selectable so the two can be compared.
+//
+// Run whatever IO is ready without blocking. Only one thread may run the IO context at a time: if another
+// thread is already polling, it will pick up anything that is ready, so just return. The flag rather than
+// a mutex also makes this safe to call from inside a handler that is already polling (e.g. a command that
+// sends an event).
+void poll_io()
+{
+    if (polling.exchange(true))
+    {
+        return;
+    }
+
+    io_thread = std::this_thread::get_id();
+    ios.poll();
+    io_thread = std::thread::id{};
+    polling = false;
+}
+
+#ifdef _WIN32
+static PTP_TIMER poll_timer = nullptr;
+
+static void CALLBACK poll_timer_callback(PTP_CALLBACK_INSTANCE, PVOID, PTP_TIMER)
+{
+    poll_io();
+}
+
+static void start_poll_timer(int interval_ms)
+{
+    poll_timer = CreateThreadpoolTimer(poll_timer_callback, nullptr, nullptr);
+    if (!poll_timer)
+    {
+        printf("Debugger: Failed to create the poll timer (error %lu)\n", GetLastError());
+        return;
+    }
+
+    // A negative due time is relative, in 100ns units.
+    ULARGE_INTEGER due;
+    due.QuadPart = static_cast<ULONGLONG>(-static_cast<LONGLONG>(interval_ms) * 10000);
+    FILETIME due_time;
+    due_time.dwLowDateTime = due.LowPart;
+    due_time.dwHighDateTime = due.HighPart;
+    SetThreadpoolTimer(poll_timer, &due_time, interval_ms, 0);
+}
+
+static void stop_poll_timer()
+{
+    if (poll_timer)
+    {
+        SetThreadpoolTimer(poll_timer, nullptr, 0, 0);
+        WaitForThreadpoolTimerCallbacks(poll_timer, TRUE);
+        CloseThreadpoolTimer(poll_timer);
+        poll_timer = nullptr;
+    }
+}
+#else
+// There is no thread pool timer outside of Windows: tick from a plain thread that does nothing but sleep
+// and poll.
+static std::thread poll_ticker;
+static std::atomic<bool> poll_ticker_stop = false;
+
+static void start_poll_timer(int interval_ms)
+{
+    poll_ticker_stop = false;
+    poll_ticker = std::thread([interval_ms]() {
+        while (!poll_ticker_stop)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+            poll_io();
+        }
+    });
+}
+
+static void stop_poll_timer()
+{
+    poll_ticker_stop = true;
+    if (poll_ticker.joinable())
+    {
+        poll_ticker.join();
+    }
+}
+#endif
+
 // Start the debugger service: create the service instance
 void start_debugger_service()
 {
@@ -208,15 +584,28 @@ void start_debugger_service()
 
     service = std::make_unique<debugger_service>();
 
+    // The IO context may have been stopped by a previous service.
+    ios.restart();
+
     // Start listening for connections.
     service->start();
 
-    // run the worker thread to service i/o
-    worker = std::thread(worker_loop);
+    poll_mode = get_env("UNREAL_DEBUGGER_IO_MODE").value_or("thread") == "poll";
+    if (poll_mode)
+    {
+        // Service i/o from Unreal's calls and the poll timer.
+        start_poll_timer(std::max(1, get_env_int("UNREAL_DEBUGGER_POLL_INTERVAL", 5)));
+        printf("Debugger: Polling for i/o\n");
+    }
+    else
+    {
+        // run the worker thread to service i/o
+        worker = std::thread(worker_loop);
+    }
 }
 
 // Try to ensure the debugger service is in a good state. Returns 'true' if the service is up
-// and we can service events, or false otherwise. A false result may mean the the service is either
+// and we can service events (whether or not a client is connected), or false otherwise. A false result may mean the the service is either
 // shut down or in the process of shutting down, but no debugger API calls can be serviced.
 bool check_service()
 {
@@ -231,12 +620,18 @@ bool check_service()
             // Stop the ASIO task service. This will allow the worker thread to halt.
             ios.stop();
 
+            if (poll_mode)
+            {
+                // There's no worker, just the poll timer. Once it has stopped nothing else will poll:
+                // Unreal's calls find the service stopped.
+                stop_poll_timer();
+            }
             // Stop the worker thread. If we ended up calling stop from a thread owned by
             // Unreal, we can just join (and this shouldn't take *too* long for the worker
             // thread to stop). If we're called on the worker thread then all we can do is detach
             // to let it unwind itself and stop (which it should do quickly, now that the io
             // context is stopped).
-            if (worker.joinable() && std::this_thread::get_id() != worker.get_id())
+            else if (worker.joinable() && std::this_thread::get_id() != worker.get_id())
             {
                 worker.join();
             }
@@ -264,9 +659,9 @@ bool check_service()
         return false;
 
     case service_state::disconnected:
-        // In the disconnected state the service is healthy but cannot yet do anything. Return false but otherwise don't
-        // take any action on the service.
-        return false;
+        // In the disconnected state the service is healthy but has no client. Events are still serviced so they can be
+        // recorded in the shadow state for the next client that connects.
+        return true;
 
     case service_state::connected:
         // The service is healthy and connected and can service commands and events.
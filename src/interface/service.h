@@ -4,12 +4,17 @@
 #include <memory>
 #include <deque>
 #include <boost/asio/io_context.hpp>
-#include <boost/asio/ip/tcp.hpp>
 #include <atomic>
 #include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "events.h"
 #include "commands.h"
+#include "frame_reader.h"
+#include "transport.h"
 
 namespace unreal_debugger::interface
 {
@@ -29,13 +34,18 @@ void start_debugger_service();
 // in shutdown mode.
 bool check_service();
 
+// Run any IO that is ready without blocking, when the service is in poll mode.
+void poll_io();
+extern bool poll_mode;
+
 enum class service_state : char
 {
     // The service is not currently running, or has encountered an error. When in this state any attempt to interact with
     // the debugger service will attempt to shut down any existing service, then start a new one.
     stopped,
 
-    // The service is currently running, but we do not have an active connection
+    // The service is currently running, but we do not have an active connection. Events are still
+    // recorded so a client that connects later can be brought up to date.
     disconnected,
 
     // The service is running and is connected to a debug client.
@@ -47,6 +57,105 @@ enum class service_state : char
 
 extern std::atomic<service_state> state;
 
+class debugger_service;
+
+// A compact record of the debugger state that a newly connected client needs to know about:
+// the breakpoints Unreal has reported, the class hierarchy, and the events that described the
+// current stop (if Unreal is stopped). When a client connects it is sent all of this in a single
+// burst, so an adapter that reconnects after a drop is immediately in the same state as the one
+// that left instead of having to rebuild it one round trip at a time.
+//
+// The shadow state is built from the stream of serialized events as they are handed to the
+// connections, so it always reflects exactly what the existing connections have been sent.
+// It is only used on the IO thread.
+class shadow_state
+{
+public:
+    // Record an event that is being sent to the connected clients.
+    void record(const serialization::shared_message& msg);
+
+    // Unreal has been told to resume execution, so the current stop is over.
+    void resume();
+
+    // Unreal has been told to switch to another stack frame.
+    void change_frame(int frame) { current_frame_ = frame; }
+    int current_frame() const { return current_frame_; }
+
+    // Build the burst of events that brings a new client up to date.
+    std::vector<serialization::shared_message> resync() const;
+
+    // The whole of the last call stack Unreal reported, as a call_stack_delta with no prefix.
+    const serialization::shared_message& call_stack() const { return call_stack_msg_; }
+
+private:
+    // Breakpoints as (class name, line) pairs, exactly as Unreal reported them.
+    std::set<std::pair<std::string, int>> breakpoints_;
+
+    // The events that built the class hierarchy, starting from the last build or clear.
+    std::vector<serialization::shared_message> hierarchy_;
+
+    // The events that described the current stop, up to and including show_dll_form. Events
+    // sent after that are responses to client requests (e.g. changing frames) and aren't recorded.
+    std::vector<serialization::shared_message> stop_;
+    bool stop_complete_ = false;
+
+    // The stack frame Unreal currently has selected.
+    int current_frame_ = 0;
+
+    // The last call stack, rebuilt from the deltas that have been sent, bottom-most entry first.
+    std::vector<std::string> stack_;
+    serialization::shared_message call_stack_msg_;
+};
+
+// A connection from a debugger client.
+//
+// The service accepts any number of connections. The first one becomes the controlling
+// connection: it receives all events and its commands are dispatched to Unreal. Any
+// connections made while there is already a controlling connection are observers, such
+// as a log viewer or a stats collector. Observers receive every event the controlling
+// connection does, but any commands they send are discarded.
+//
+// Each event is serialized once by the service and the same shared buffer is queued to
+// every connection, so an observer costs nothing extra on Unreal's thread. All connection
+// methods run on the IO thread.
+class connection : public std::enable_shared_from_this<connection>
+{
+public:
+    using protocol = transport::protocol;
+
+    connection(debugger_service& svc, protocol::socket socket, bool controlling);
+
+    // Start reading commands from the client.
+    void start();
+
+    // Queue a message, or a burst of messages, to be sent to the client.
+    void send(const serialization::shared_message& msg);
+    void send(const std::vector<serialization::shared_message>& msgs);
+
+    void close();
+
+    bool is_controlling() const { return controlling_; }
+
+    // Whether this client has been sent a call stack that later call stack deltas are relative to.
+    bool has_call_stack() const { return has_call_stack_; }
+    void set_has_call_stack() { has_call_stack_ = true; }
+
+private:
+    void write_pending();
+
+    debugger_service& service_;
+    protocol::socket socket_;
+    serialization::frame_reader<protocol::socket> reader_;
+    bool controlling_;
+    bool has_call_stack_ = false;
+
+    // Messages waiting to be written, and the messages in the write currently in flight.
+    // Everything queued while a write is in progress goes out together in the next write.
+    std::vector<serialization::shared_message> pending_;
+    std::vector<serialization::shared_message> writing_;
+    std::vector<boost::asio::const_buffer> buffers_;
+};
+
 // An object representing the debugger state.
 class debugger_service
 {
@@ -92,7 +201,8 @@ public:
     // to unreal through the callback pointer provided by Unreal as simple strings.
     /////////////////
 
-    void dispatch_command(const serialization::message& msg);
+    void dispatch_command(const serialization::message_view& msg);
+    void run_command(const serialization::message_view& msg);
     void add_breakpoint(const commands::add_breakpoint& cmd);
     void remove_breakpoint(const commands::remove_breakpoint& cmd);
     void add_watch(const commands::add_watch& cmd);
@@ -108,13 +218,23 @@ public:
     void step_over(const commands::step_over& cmd);
     void step_out_of(const commands::step_out_of& cmd);
     void toggle_watch_info(const commands::toggle_watch_info& cmd);
+    void resume(const commands::resume& cmd);
 
 private:
+    friend class connection;
+
     void send_event(const events::event& ev);
-    void send_next_message();
-    void receive_next_message();
+    void queue_event(serialization::shared_message msg);
+    void release_watches();
+    void send_call_stack();
+    void flush_events();
+    template <typename Messages>
+    void deliver(const Messages& messages);
+    void resuming();
     void accept_connection();
+    void connection_closed(const std::shared_ptr<connection>& conn, const boost::system::error_code& ec);
     void fatal_error(const char* msg, ...);
+    void report_send_lock_stats();
 
     // Maintain a record of the indices we have assigned to each of the three
    // watch kinds unreal implements. These values are used by clear_a_watch
@@ -131,20 +251,42 @@ private:
     // and add watch events are silently discarded.
     bool send_watch_info_ = true;
 
-    // A queue of serialized messages waiting to be sent.
-    serialization::locked_message_queue send_queue_;
-    
-    // The command message currently being read from the debugger client.
-    // There is only a single element, not a queue, because only a single
-    // thread reads these messages and they are processed entirely before the
-    // next one is read.
-    serialization::message next_command_;
+    // The call stack last sent to the clients, and the one Unreal is in the middle of sending. Both
+    // are in the order Unreal sends them, bottom-most entry first. Only used on Unreal's thread.
+    std::vector<std::string> call_stack_;
+    std::vector<std::string> new_call_stack_;
+    bool building_call_stack_ = false;
+
+    // Whether Unreal is stopped, as far as the interface knows. Set on Unreal's thread at the start
+    // of a stop and cleared on the IO thread when Unreal is resumed.
+    std::atomic<bool> in_stop_ = false;
+
+    // Watch list events held back at the start of a stop until the call stack has been sent. Only
+    // used on Unreal's thread.
+    std::vector<serialization::shared_message> deferred_watches_;
+    bool defer_watches_ = false;
+
+    // Events Unreal has produced from inside the callback while a command is being dispatched, and the
+    // thread doing the dispatch. See dispatch_command.
+    std::vector<serialization::shared_message> dispatch_events_;
+    std::atomic<std::thread::id> dispatch_thread_;
+
+    // A queue of serialized events waiting to be handed to the connections.
+    serialization::locked_queue<serialization::shared_message> send_queue_;
+
+    // How long Unreal's thread has spent waiting for the send queue's lock.
+    serialization::lock_wait_stats send_lock_stats_;
+
+    using protocol = transport::protocol;
 
-    using tcp = boost::asio::ip::tcp;
+    // Listening acceptor and the connected clients. The connection list is only touched on
+    // the IO thread. The count of connections can be read from any thread.
+    std::unique_ptr<transport::acceptor> acceptor_;
+    std::vector<std::shared_ptr<connection>> connections_;
+    std::atomic<int> connection_count_ = 0;
 
-    // Listening acceptor and the connected socket.
-    std::unique_ptr<tcp::acceptor> acceptor_;
-    std::unique_ptr<tcp::socket> socket_;
+    // The state to replay to newly connected clients.
+    shadow_state shadow_;
 };
 
 // The callback function back into unreal just takes a simple string argument
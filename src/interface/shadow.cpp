@@ -0,0 +1,112 @@
+
+#include <algorithm>
+
+#include "service.h"
+
+// Track the shadow state of the debugger for resynchronizing clients that connect while
+// the debugger is already running. See the shadow_state class for details.
+
+namespace unreal_debugger::interface
+{
+
+void shadow_state::record(const serialization::shared_message& msg)
+{
+    char* buf = msg->buf_.get();
+    events::event_kind k = serialization::deserialize_event_kind(buf);
+
+    switch (k)
+    {
+    case events::event_kind::add_breakpoint:
+    {
+        events::add_breakpoint ev{ *msg };
+        breakpoints_.emplace(ev.class_name_, ev.line_number_);
+        return;
+    }
+
+    case events::event_kind::remove_breakpoint:
+    {
+        events::remove_breakpoint ev{ *msg };
+        breakpoints_.erase({ ev.class_name_, ev.line_number_ });
+        return;
+    }
+
+    case events::event_kind::build_hierarchy:
+    case events::event_kind::clear_hierarchy:
+        // Either of these starts a new hierarchy: nothing before it matters anymore.
+        hierarchy_.clear();
+        hierarchy_.push_back(msg);
+        return;
+
+    case events::event_kind::add_class_to_hierarchy:
+        hierarchy_.push_back(msg);
+        return;
+
+    case events::event_kind::stop_begin:
+    case events::event_kind::editor_load_class:
+    case events::event_kind::editor_goto_line:
+    case events::event_kind::clear_a_watch:
+    case events::event_kind::lock_list:
+    case events::event_kind::unlock_list:
+    case events::event_kind::set_current_object_name:
+        if (!stop_complete_)
+        {
+            stop_.push_back(msg);
+        }
+        return;
+
+    case events::event_kind::call_stack_delta:
+    {
+        // Keep the whole stack, so that a client that connects later can be sent it in full rather
+        // than as a delta against a stack it has never seen.
+        events::call_stack_delta::view delta{ *msg };
+        stack_.resize(std::min<std::size_t>(delta.prefix_, stack_.size()));
+        stack_.insert(stack_.end(), delta.entries_.begin(), delta.entries_.end());
+        call_stack_msg_ = std::make_shared<const serialization::message>(events::call_stack_delta{ 0, stack_ }.serialize());
+
+        if (!stop_complete_)
+        {
+            stop_.push_back(call_stack_msg_);
+        }
+        return;
+    }
+
+    case events::event_kind::show_dll_form:
+        if (!stop_complete_)
+        {
+            stop_.push_back(msg);
+            stop_complete_ = true;
+        }
+        return;
+
+    default:
+        // Log lines and termination are not part of the state.
+        return;
+    }
+}
+
+void shadow_state::resume()
+{
+    stop_.clear();
+    stop_complete_ = false;
+    current_frame_ = 0;
+}
+
+// The resync burst is the breakpoints, then the hierarchy, then the stop. The stop may only be
+// partially recorded if Unreal is in the middle of breaking: the rest of it follows as ordinary
+// events.
+std::vector<serialization::shared_message> shadow_state::resync() const
+{
+    std::vector<serialization::shared_message> msgs;
+    msgs.reserve(breakpoints_.size() + hierarchy_.size() + stop_.size());
+
+    for (const auto& [class_name, line] : breakpoints_)
+    {
+        msgs.push_back(std::make_shared<const serialization::message>(events::add_breakpoint{ class_name.c_str(), line }.serialize()));
+    }
+
+    msgs.insert(msgs.end(), hierarchy_.begin(), hierarchy_.end());
+    msgs.insert(msgs.end(), stop_.begin(), stop_.end());
+    return msgs;
+}
+
+}